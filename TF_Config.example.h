@@ -29,17 +29,47 @@
 #define TF_LEN_BYTES    2
 #define TF_TYPE_BYTES   1
 
+// Send LEN and TYPE as varints - 7 bits per byte, the top bit set in all but the last.
+// Values below 128 take one byte, so short frames and small types get a shorter head
+// even with TF_LEN_BYTES 4; the sizes above then only set the largest value. TF_TYPE_BYTES 1
+// types from 0x80 up (the reserved ones included) take 2 bytes. The ID stays fixed-width.
+#define TF_USE_VARINT   0
+
 // Checksum type. Options:
-//   TF_CKSUM_NONE, TF_CKSUM_XOR, TF_CKSUM_CRC8, TF_CKSUM_CRC16, TF_CKSUM_CRC32
+//   TF_CKSUM_NONE, TF_CKSUM_XOR, TF_CKSUM_CRC8, TF_CKSUM_CRC16, TF_CKSUM_CRC32, TF_CKSUM_CRC32C
 //   TF_CKSUM_CUSTOM8, TF_CKSUM_CUSTOM16, TF_CKSUM_CUSTOM32
 // Custom checksums require you to implement checksum functions (see TinyFrame.h)
 #define TF_CKSUM_TYPE TF_CKSUM_CRC16
 
+// Bytes processed per step by the CRC8/16/32 block checksum (slicing-by-N).
+// 4 or 8 builds N lookup tables in RAM on init (N*256*sizeof(TF_CKSUM) bytes),
+// 1 uses only the built-in byte table.
+#define TF_CKSUM_SLICING 1
+
+// Use CPU instructions for CRC32 / CRC32C when available (x86-64 with GCC or Clang:
+// SSE4.2 crc32, PCLMULQDQ; checked at runtime, falls back to the tables)
+#define TF_CKSUM_HW 1
+
+// Custom checksums only: set to 1 if you also implement TF_CksumAddBlock()
+#define TF_CKSUM_CUSTOM_BLOCK 0
+
 // Use a SOF byte to mark the start of a frame
 #define TF_USE_SOF_BYTE 1
 // Value of the SOF byte (if TF_USE_SOF_BYTE == 1)
 #define TF_SOF_BYTE     0x01
 
+// Frame with COBS (Consistent Overhead Byte Stuffing) instead of a SOF byte: frames are
+// encoded to contain no zero bytes and each is followed by a zero, at most 1 byte of
+// overhead per 254 bytes plus the zero. A corrupted frame costs only itself - the parser
+// starts again at the next zero. Needs TF_USE_SOF_BYTE 0; not with TF_USE_WRITEV,
+// TF_USE_TX_QUEUE or TF_USE_MPSC_TX. Uses TF_SENDBUF_LEN + 256 bytes for encoding.
+#define TF_USE_COBS     0
+
+// When a header checksum fails, look for another SOF among the header bytes
+// instead of skipping them all - a corrupted byte then costs one frame, not the
+// frame after it too. Needs TF_USE_SOF_BYTE.
+#define TF_USE_RESYNC   0
+
 //----------------------- PLATFORM COMPATIBILITY ----------------------------
 
 // used for timeout tick counters - should be large enough for all used timeouts
@@ -53,22 +83,141 @@ typedef uint8_t TF_COUNT;
 // Maximum received payload size (static buffer)
 // Larger payloads will be rejected.
 #define TF_MAX_PAYLOAD_RX 1024
+// Take RX buffers from a pool shared by instances (see TF_RxPoolInit) instead of
+// a TF_MAX_PAYLOAD_RX buffer in each one. Pool size classes (max nr of classes):
+#define TF_USE_RX_POOL 0
+#define TF_RX_POOL_CLASSES 3
+// Deliver received payloads straight from the buffer passed to TF_Accept() when the
+// whole frame is in it, instead of copying to the internal buffer first.
+// msg.data then points into your RX buffer.
+#define TF_USE_ZEROCOPY_RX 0
+// Queue received frames and run the listeners from TF_DispatchPending(), which can be
+// called from another thread than the one feeding the parser. The queue holds
+// TF_RX_QUEUE_LEN - 1 frames, each with a TF_MAX_PAYLOAD_RX buffer (unless TF_USE_RX_POOL
+// is used - then the pool buffer is queued). TF_USE_ZEROCOPY_RX is not used in this mode.
+#define TF_USE_RX_QUEUE 0
+#define TF_RX_QUEUE_LEN 8
 // Size of the sending buffer. Larger payloads will be split to pieces and sent
 // in multiple calls to the write function. This can be lowered to reduce RAM usage.
 #define TF_SENDBUF_LEN    128
+// Send frames through TF_WriteImplV() (implement it instead of TF_WriteImpl()), which gets
+// the head, payload and checksum as separate pieces, like writev(). The payload is not copied
+// to the send buffer, and a frame goes out in one call. TF_SENDBUF_LEN then only needs to
+// hold the head and checksum.
+#define TF_USE_WRITEV 0
+// Encode frames to a queue of TF_TX_QUEUE_LEN bytes (a power of two) instead of writing them,
+// the application then sends them with TF_TxDrain() / TF_TxComplete() when the link is ready.
+// Sending fails if a frame doesn't fit, or if TF_TX_QUEUE_FRAMES - 1 frames are already queued.
+// Frames can have a completion callback (TF_Msg.tx_done). Can't be used with TF_USE_WRITEV.
+#define TF_USE_TX_QUEUE 0
+#define TF_TX_QUEUE_LEN 1024
+#define TF_TX_QUEUE_FRAMES 8
+// Nr of TX priority classes, each with its own queue of the above size. A frame's class is
+// TF_Msg.priority (higher is more urgent), or TF_TX_TYPE_PRIORITY(type) if that's higher (optional).
+// TF_TxDrain() switches classes between frames, as chosen by TF_TX_SCHED:
+//   TF_TX_SCHED_STRICT   - the most urgent frame first
+//   TF_TX_SCHED_WEIGHTED - classes take turns, with frame counts set by TF_TxSetWeight()
+#define TF_TX_PRIORITIES 1
+//#define TF_TX_TYPE_PRIORITY(type) ((type) < 0x10 ? 1 : 0)
+#define TF_TX_SCHED TF_TX_SCHED_STRICT
+// Measure the queueing delay of each class (TF_TxGetStats), timed by TF_TxTimestamp() (implement it)
+#define TF_TX_STATS 0
+// Let threads encode frames on their own (TF_EncodeFrame) and submit them to a lock-free queue
+// (TF_Submit), written by one writer thread (TF_WriteSubmitted). Can't be used with TF_USE_TX_QUEUE
+// or TF_USE_FLOW_CONTROL.
+#define TF_USE_MPSC_TX 0
 
 // --- Listener counts - determine sizes of the static slot tables ---
 
 // Frame ID listeners (wait for response / multi-part message)
 #define TF_MAX_ID_LST   10
+// Find ID listeners through a hash index instead of scanning the table - worth it
+// with many pending queries. Index size: a power of two larger than TF_MAX_ID_LST,
+// preferably at least twice as large.
+#define TF_USE_ID_HASH  0
+#define TF_ID_HASH_SIZE 32
+// Expire ID listeners using a timer wheel, so TF_Tick() only visits listeners whose
+// deadline falls on the current tick modulo TF_TIMER_WHEEL_SIZE, instead of all of them.
+// Size: a power of two, ideally larger than the common timeouts (in ticks).
+#define TF_USE_TIMER_WHEEL  0
+#define TF_TIMER_WHEEL_SIZE 64
 // Frame Type listeners (wait for frame with a specific first payload byte)
 #define TF_MAX_TYPE_LST 10
+// How Type listeners are found for a received frame:
+//   TF_TYPE_DISPATCH_LINEAR - scan the table (smallest)
+//   TF_TYPE_DISPATCH_SORTED - binary search in a sorted copy of the types (TF_MAX_TYPE_LST entries)
+//   TF_TYPE_DISPATCH_DIRECT - one table lookup (256 TF_COUNTs), needs TF_TYPE_BYTES 1
+#define TF_TYPE_DISPATCH TF_TYPE_DISPATCH_LINEAR
 // Generic listeners (fallback if no other listener catches it)
 #define TF_MAX_GEN_LST  5
 
+// Allocate the listener tables on demand, with TF_Alloc() and TF_Free() (implement them).
+// They start at TF_LST_INITIAL slots and double when full, up to the TF_MAX_*_LST counts above,
+// which can then be much larger (TF_COUNT must be large enough). Memory is freed by TF_DeInit(),
+// or TF_DeInitStatic() for an instance set up with TF_InitStatic().
+#define TF_USE_DYNAMIC_LST 0
+#define TF_LST_INITIAL     8
+
+// Stream listeners (receive payloads of any length in pieces, see TF_AddStreamListener)
+#define TF_USE_STREAM_RX 0
+#define TF_MAX_STREAM_LST 4
+
+// Fragmented messages (see TF_Send_Fragmented): long payloads are sent as frames of type
+// TF_FRAG_TYPE (reserved, pick one your application doesn't use) with up to TF_FRAG_SIZE
+// bytes each, so other frames can be sent in between. TF_MAX_FRAG_TX messages can be sent
+// at once, TF_MAX_FRAG_RX received at once - each with a TF_FRAG_MAX_LEN reassembly buffer.
+#define TF_USE_FRAGMENTS 0
+#define TF_FRAG_TYPE     0xFF
+#define TF_FRAG_SIZE     256
+#define TF_FRAG_MAX_LEN  4096
+#define TF_MAX_FRAG_TX   2
+#define TF_MAX_FRAG_RX   2
+
+// Credit-based flow control: a peer sends at most TF_FLOW_FRAMES frames (and TF_FLOW_BYTES
+// payload bytes, 0 = not limited) that the other side hasn't handled yet - sending fails
+// until it returns credit, with frames of type TF_FLOW_TYPE (reserved). Set the window to
+// what the receiver can hold, e.g. TF_RX_QUEUE_LEN - 1 frames. A blocked sender asks for
+// credit every TF_FLOW_PROBE_TICKS ticks, in case frames were lost. TF_FLOW_QUERIES limits
+// the queries waiting for a response (0 = not limited). Both peers need the same settings.
+// Can't be used with TF_USE_MPSC_TX.
+#define TF_USE_FLOW_CONTROL 0
+#define TF_FLOW_TYPE        0xFE
+#define TF_FLOW_FRAMES      4
+#define TF_FLOW_BYTES       0
+#define TF_FLOW_PROBE_TICKS 10
+#define TF_FLOW_QUERIES     0
+
+// Reliable delivery (see TF_SendReliable): messages are sent in frames of type TF_REL_TYPE
+// (reserved) with a sequence nr, acknowledged by the peer and sent again if lost. Up to
+// TF_REL_WINDOW messages (1, 2, 4 ... 32) of up to TF_REL_MAX_LEN bytes can wait for an ack -
+// the sender keeps copies, the receiver keeps ones that came before a lost one. They're sent
+// again after TF_REL_TIMEOUT_TICKS (more than a round trip), at most TF_REL_RETRIES times.
+// The receiver acks every TF_REL_ACK_EVERY messages, or on the next tick.
+#define TF_USE_RELIABLE      0
+#define TF_REL_TYPE          0xFD
+#define TF_REL_WINDOW        8
+#define TF_REL_MAX_LEN       64
+#define TF_REL_TIMEOUT_TICKS 5
+#define TF_REL_RETRIES       10
+#define TF_REL_ACK_EVERY     4
+
+// Compression: TF_Send(), TF_Query() and TF_Respond() compress payloads of TF_COMP_THRESHOLD
+// (at least 16) to TF_COMP_MAX_LEN bytes with a small LZ codec, and send them in frames of
+// type TF_COMP_TYPE (reserved) if they come out shorter. The receiver passes them to the
+// listeners decompressed, with their type. Needs two TF_COMP_MAX_LEN buffers and a table of
+// 2^TF_COMP_HASH_BITS uint16's - more bits find more matches. Both peers need the same settings.
+#define TF_USE_COMPRESSION 0
+#define TF_COMP_TYPE       0xFC
+#define TF_COMP_THRESHOLD  32
+#define TF_COMP_MAX_LEN    256
+#define TF_COMP_HASH_BITS  8
+
 // Timeout for receiving & parsing a frame
 // ticks = number of calls to TF_Tick()
 #define TF_PARSER_TIMEOUT_TICKS 10
+// Tick period in milliseconds, for TF_TickMs() / TF_NextDeadlineMs() and TF_MS_TO_TICKS().
+// 0 = those are not available.
+#define TF_TICK_MS 0
 
 // Whether to use mutex - requires you to implement TF_ClaimTx() and TF_ReleaseTx()
 #define TF_USE_MUTEX  1
@@ -53,3 +53,12 @@ TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
 {
     return cksum;
 }
+
+#if TF_CKSUM_CUSTOM_BLOCK
+/** Update a checksum with a block of bytes */
+TF_CKSUM TF_CksumAddBlock(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+{
+    while (len--) cksum ^= *data++;
+    return cksum;
+}
+#endif
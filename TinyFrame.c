@@ -15,11 +15,32 @@
 #define TF_MIN(a, b) ((a)<(b)?(a):(b))
 #define TF_TRY(func) do { if(!(func)) return false; } while (0)
 
+#if TF_USE_RX_QUEUE || TF_USE_TX_QUEUE || TF_USE_MPSC_TX || TF_USE_FLOW_CONTROL
+// Access to the RX / TX queue indices, shared by the threads on either end of the queue,
+// and to the flow control limits, set by the receiving thread and used by the sending one
+#define TF_ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define TF_ATOMIC_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#endif
+
 
 // Type-dependent masks for bit manipulation in the ID field
 #define TF_ID_MASK (TF_ID)(((TF_ID)1 << (sizeof(TF_ID)*8 - 1)) - 1)
 #define TF_ID_PEERBIT (TF_ID)((TF_ID)1 << ((sizeof(TF_ID)*8) - 1))
 
+// Nr of checksum bytes after a payload
+#if TF_CKSUM_TYPE == TF_CKSUM_NONE
+    #define TF_CKSUM_LEN 0
+#else
+    #define TF_CKSUM_LEN sizeof(TF_CKSUM)
+#endif
+
+// Nr of bytes before the payload (at most, with varints)
+#if TF_USE_SOF_BYTE
+    #define TF_HEAD_LEN (1 + TF_ID_BYTES + TF_LEN_FIELD_MAX + TF_TYPE_FIELD_MAX + TF_CKSUM_LEN)
+#else
+    #define TF_HEAD_LEN (TF_ID_BYTES + TF_LEN_FIELD_MAX + TF_TYPE_FIELD_MAX + TF_CKSUM_LEN)
+#endif
+
 
 #if !TF_USE_MUTEX
     // Not thread safe lock implementation, used if user did not provide a better one.
@@ -57,6 +78,9 @@
     static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
       { return cksum; }
 
+    static TF_CKSUM TF_CksumAddBlock(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+      { return cksum; }
+
 #elif TF_CKSUM_TYPE == TF_CKSUM_XOR
 
     static TF_CKSUM TF_CksumStart(void)
@@ -68,6 +92,24 @@
     static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
       { return (TF_CKSUM) ~cksum; }
 
+    /** XOR a word at a time, then fold the word into the byte checksum */
+    static TF_CKSUM TF_CksumAddBlock(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        uint32_t acc = 0;
+        uint32_t word;
+
+        for (; len >= sizeof(word); len -= sizeof(word), data += sizeof(word)) {
+            memcpy(&word, data, sizeof(word)); // may be unaligned
+            acc ^= word;
+        }
+        acc ^= acc >> 16;
+        acc ^= acc >> 8;
+        cksum ^= (uint8_t) acc;
+
+        while (len--) cksum ^= *data++;
+        return cksum;
+    }
+
 #elif TF_CKSUM_TYPE == TF_CKSUM_CRC8
 
     static inline uint8_t crc8_bits(uint8_t data)
@@ -199,218 +241,1380 @@
     static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
       { return (TF_CKSUM) ~cksum; }
 
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC32C
+
+    static const uint32_t crc32c_table[] = { /* CRC polynomial 0x82f63b78 */
+        0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c,
+        0x26a1e7e8, 0xd4ca64eb, 0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+        0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24, 0x105ec76f, 0xe235446c,
+        0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+        0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc,
+        0xbc267848, 0x4e4dfb4b, 0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+        0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35, 0xaa64d611, 0x580f5512,
+        0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+        0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad,
+        0x1642ae59, 0xe4292d5a, 0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+        0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595, 0x417b1dbc, 0xb3109ebf,
+        0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+        0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f,
+        0xed03a29b, 0x1f682198, 0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+        0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38, 0xdbfc821c, 0x2997011f,
+        0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+        0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e,
+        0x4767748a, 0xb50cf789, 0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+        0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46, 0x7198540d, 0x83f3d70e,
+        0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+        0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de,
+        0xdde0eb2a, 0x2f8b6829, 0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+        0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93, 0x082f63b7, 0xfa44e0b4,
+        0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+        0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b,
+        0xb4091bff, 0x466298fc, 0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+        0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033, 0xa24bb5a6, 0x502036a5,
+        0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+        0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975,
+        0x0e330a81, 0xfc588982, 0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+        0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622, 0x38cc2a06, 0xcaa7a905,
+        0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+        0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8,
+        0xe52cc12c, 0x1747422f, 0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+        0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0, 0xd3d3e1ab, 0x21b862a8,
+        0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+        0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78,
+        0x7fab5e8c, 0x8dc0dd8f, 0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+        0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1, 0x69e9f0d5, 0x9b8273d6,
+        0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+        0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69,
+        0xd5cf889d, 0x27a40b9e, 0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+        0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+    };
+
+    static TF_CKSUM TF_CksumStart(void)
+      { return (TF_CKSUM)0xFFFFFFFF; }
+
+    static TF_CKSUM TF_CksumAdd(TF_CKSUM cksum, uint8_t byte)
+      { return crc32c_table[((cksum) ^ ((uint8_t)byte)) & 0xff] ^ ((cksum) >> 8); }
+
+    static TF_CKSUM TF_CksumEnd(TF_CKSUM cksum)
+      { return (TF_CKSUM) ~cksum; }
+
+#elif !TF_CKSUM_CUSTOM_BLOCK
+
+    /** Custom checksum without a block function - feed it byte by byte */
+    static TF_CKSUM TF_CksumAddBlock(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        while (len--) cksum = TF_CksumAdd(cksum, *data++);
+        return cksum;
+    }
+
 #endif
 
-#define CKSUM_RESET(cksum)     do { (cksum) = TF_CksumStart(); } while (0)
-#define CKSUM_ADD(cksum, byte) do { (cksum) = TF_CksumAdd((cksum), (byte)); } while (0)
-#define CKSUM_FINALIZE(cksum)  do { (cksum) = TF_CksumEnd((cksum)); } while (0)
+// CPU CRC instructions on x86-64 (SSE4.2 crc32 for CRC32C, PCLMULQDQ folding for CRC32).
+// Support is checked with CPUID on init, the table code is used as a fallback.
+#if TF_CKSUM_HW && ((TF_CKSUM_TYPE == TF_CKSUM_CRC32) || (TF_CKSUM_TYPE == TF_CKSUM_CRC32C)) \
+    && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define TF_CKSUM_X86 1
+    #define CKSUM_BLOCK_SW TF_CksumAddBlockSw
+#else
+    #define CKSUM_BLOCK_SW TF_CksumAddBlock
+#endif
 
-//endregion
+#if (TF_CKSUM_TYPE == TF_CKSUM_CRC8) || (TF_CKSUM_TYPE == TF_CKSUM_CRC16) \
+    || (TF_CKSUM_TYPE == TF_CKSUM_CRC32) || (TF_CKSUM_TYPE == TF_CKSUM_CRC32C)
+  #if TF_CKSUM_SLICING == 4 || TF_CKSUM_SLICING == 8
+    // Slicing-by-N tables, derived from the byte-wise function when an instance is initialized.
+    // cksum_slices[k][i] is the CRC of byte i followed by k zero bytes.
+    static TF_CKSUM cksum_slices[TF_CKSUM_SLICING][256];
 
+    static void _TF_FN TF_CksumInitTables(void)
+    {
+        uint32_t i, k;
 
-//region Init
+        for (i = 0; i < 256; i++) {
+            cksum_slices[0][i] = TF_CksumAdd(0, (uint8_t) i);
+        }
+        for (k = 1; k < TF_CKSUM_SLICING; k++) {
+            for (i = 0; i < 256; i++) {
+                cksum_slices[k][i] = (TF_CKSUM) (cksum_slices[k-1][i] >> 8)
+                                     ^ cksum_slices[0][cksum_slices[k-1][i] & 0xff];
+            }
+        }
+    }
 
-/** Init with a user-allocated buffer */
-bool _TF_FN TF_InitStatic(TinyFrame *tf, TF_Peer peer_bit)
-{
-    if (tf == NULL) {
-        TF_Error("TF_InitStatic() failed, tf is null.");
-        return false;
+    /** Reflected CRC, TF_CKSUM_SLICING bytes per step */
+    static TF_CKSUM CKSUM_BLOCK_SW(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        uint8_t blk[TF_CKSUM_SLICING];
+        uint32_t j;
+
+        for (; len >= TF_CKSUM_SLICING; len -= TF_CKSUM_SLICING, data += TF_CKSUM_SLICING) {
+            memcpy(blk, data, TF_CKSUM_SLICING);
+            for (j = 0; j < sizeof(TF_CKSUM); j++) {
+                blk[j] ^= (uint8_t) (cksum >> (j*8));
+            }
+            cksum = 0;
+            for (j = 0; j < TF_CKSUM_SLICING; j++) {
+                cksum ^= cksum_slices[TF_CKSUM_SLICING - 1 - j][blk[j]];
+            }
+        }
+
+        while (len--) cksum = TF_CksumAdd(cksum, *data++);
+        return cksum;
     }
+  #else
+    static inline void TF_CksumInitTables(void) {}
 
-    // Zero it out, keeping user config
-    uint32_t usertag = tf->usertag;
-    void * userdata = tf->userdata;
+    static TF_CKSUM CKSUM_BLOCK_SW(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        while (len--) cksum = TF_CksumAdd(cksum, *data++);
+        return cksum;
+    }
+  #endif
+#endif
 
-    memset(tf, 0, sizeof(struct TinyFrame_));
+#if TF_CKSUM_X86
+    #include <immintrin.h>
 
-    tf->usertag = usertag;
-    tf->userdata = userdata;
+    static bool cksum_hw_ok = false; //!< CPU support was detected
 
-    tf->peer_bit = peer_bit;
-    return true;
-}
+  #if TF_CKSUM_TYPE == TF_CKSUM_CRC32C
 
-/** Init with malloc */
-TinyFrame * _TF_FN TF_Init(TF_Peer peer_bit)
-{
-    TinyFrame *tf = malloc(sizeof(TinyFrame));
-    if (!tf) {
-        TF_Error("TF_Init() failed, out of memory.");
-        return NULL;
+    static void _TF_FN TF_CksumInit(void)
+    {
+        TF_CksumInitTables();
+        __builtin_cpu_init();
+        cksum_hw_ok = __builtin_cpu_supports("sse4.2");
     }
 
-    TF_InitStatic(tf, peer_bit);
-    return tf;
-}
+    /** CRC32C using the SSE4.2 crc32 instruction, 8 bytes at a time */
+    __attribute__((target("sse4.2")))
+    static TF_CKSUM TF_CksumAddBlockHw(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        uint64_t crc = cksum;
+        uint64_t word;
 
-/** Release the struct */
-void TF_DeInit(TinyFrame *tf)
+        for (; len >= sizeof(word); len -= sizeof(word), data += sizeof(word)) {
+            memcpy(&word, data, sizeof(word));
+            crc = _mm_crc32_u64(crc, word);
+        }
+        while (len--) crc = _mm_crc32_u8((uint32_t) crc, *data++);
+        return (TF_CKSUM) crc;
+    }
+
+    #define CKSUM_HW_MIN_LEN 8
+
+  #else
+
+    static void _TF_FN TF_CksumInit(void)
+    {
+        TF_CksumInitTables();
+        __builtin_cpu_init();
+        cksum_hw_ok = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+    }
+
+    /**
+     * CRC32 by folding 4x128 bits at a time with carry-less multiplication, then Barrett
+     * reduction (Intel, "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ").
+     * len must be a multiple of 16, at least 64.
+     */
+    __attribute__((target("pclmul,sse4.1")))
+    static TF_CKSUM TF_CksumFoldPclmul(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+        const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+        const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+        const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+        const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+        __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+        x1 = _mm_loadu_si128((const __m128i *) (data + 0x00));
+        x2 = _mm_loadu_si128((const __m128i *) (data + 0x10));
+        x3 = _mm_loadu_si128((const __m128i *) (data + 0x20));
+        x4 = _mm_loadu_si128((const __m128i *) (data + 0x30));
+        x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) cksum));
+        data += 64;
+        len -= 64;
+
+        // Fold 4 lanes in parallel
+        for (; len >= 64; len -= 64, data += 64) {
+            x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+            x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+            x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+            x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+            x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+            x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+            x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *) (data + 0x00)));
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *) (data + 0x10)));
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *) (data + 0x20)));
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *) (data + 0x30)));
+        }
+
+        // Fold the lanes into one
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+        // Remaining 16-byte blocks
+        for (; len >= 16; len -= 16, data += 16) {
+            x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+            x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *) data)), x5);
+        }
+
+        // 128 -> 64 bits
+        x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_and_si128(x1, mask32);
+        x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        // Barrett reduction to 32 bits
+        x2 = _mm_and_si128(x1, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+        x2 = _mm_and_si128(x2, mask32);
+        x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        return (TF_CKSUM) _mm_extract_epi32(x1, 1);
+    }
+
+    static TF_CKSUM TF_CksumAddBlockHw(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        uint32_t folded = len & ~(uint32_t) 15;
+
+        cksum = TF_CksumFoldPclmul(cksum, data, folded);
+        return TF_CksumAddBlockSw(cksum, data + folded, len - folded);
+    }
+
+    #define CKSUM_HW_MIN_LEN 64
+
+  #endif
+
+    static TF_CKSUM TF_CksumAddBlock(TF_CKSUM cksum, const uint8_t *data, uint32_t len)
+    {
+        if (cksum_hw_ok && len >= CKSUM_HW_MIN_LEN) {
+            return TF_CksumAddBlockHw(cksum, data, len);
+        }
+        return TF_CksumAddBlockSw(cksum, data, len);
+    }
+
+    #define CKSUM_SETUP() TF_CksumInit()
+
+#elif ((TF_CKSUM_TYPE == TF_CKSUM_CRC8) || (TF_CKSUM_TYPE == TF_CKSUM_CRC16) \
+    || (TF_CKSUM_TYPE == TF_CKSUM_CRC32) || (TF_CKSUM_TYPE == TF_CKSUM_CRC32C)) \
+    && (TF_CKSUM_SLICING == 4 || TF_CKSUM_SLICING == 8)
+    #define CKSUM_SETUP() TF_CksumInitTables()
+#endif
+
+#ifdef CKSUM_SETUP
+// The tables and the CPU check are shared by all instances. The first TF_InitStatic() sets
+// them up, instances initialized in other threads meanwhile wait until it's done.
+static uint8_t cksum_setup_state = 0; // 0 = not yet, 1 = in progress, 2 = done
+
+static void _TF_FN TF_CksumSetupOnce(void)
 {
-    if (tf == NULL) return;
-    free(tf);
+    uint8_t expected = 0;
+
+    if (__atomic_load_n(&cksum_setup_state, __ATOMIC_ACQUIRE) == 2) return;
+
+    if (__atomic_compare_exchange_n(&cksum_setup_state, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        CKSUM_SETUP();
+        __atomic_store_n(&cksum_setup_state, 2, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(&cksum_setup_state, __ATOMIC_ACQUIRE) != 2);
 }
 
-//endregion Init
+    #define CKSUM_INIT() TF_CksumSetupOnce()
+#else
+    #define CKSUM_INIT() do {} while (0)
+#endif
+
+#define CKSUM_RESET(cksum)     do { (cksum) = TF_CksumStart(); } while (0)
+#define CKSUM_ADD(cksum, byte) do { (cksum) = TF_CksumAdd((cksum), (byte)); } while (0)
+#define CKSUM_ADD_BLOCK(cksum, data, len) do { (cksum) = TF_CksumAddBlock((cksum), (data), (len)); } while (0)
+#define CKSUM_FINALIZE(cksum)  do { (cksum) = TF_CksumEnd((cksum)); } while (0)
+
+//endregion
 
 
-//region Listeners
+#if TF_USE_RX_POOL
+//region RX buffer pool
 
-/** Reset ID listener's timeout to the original value */
-static inline void _TF_FN renew_id_listener(struct TF_IdListener_ *lst)
+#define RXPOOL_LOCK(pool) do { if ((pool)->lock) (pool)->lock(pool); } while(0)
+#define RXPOOL_UNLOCK(pool) do { if ((pool)->unlock) (pool)->unlock(pool); } while(0)
+
+/** Init a RX buffer pool */
+void _TF_FN TF_RxPoolInit(TF_RxPool *pool)
 {
-    lst->timeout = lst->timeout_max;
+    memset(pool, 0, sizeof(TF_RxPool));
 }
 
-/** Notify callback about ID listener's demise & let it free any resources in userdata */
-static void _TF_FN cleanup_id_listener(TinyFrame *tf, TF_COUNT i, struct TF_IdListener_ *lst)
+/** Add a size class to a pool, chaining its buffers into the free list */
+bool _TF_FN TF_RxPoolAddClass(TF_RxPool *pool, uint8_t *storage, TF_LEN size, uint16_t count)
 {
-    TF_Msg msg;
-    if (lst->fn == NULL) return;
+    TF_RxPoolClass *cls;
+    uint8_t *next = NULL;
+    uint16_t i;
 
-    // Make user clean up their data - only if not NULL
-    if (lst->userdata != NULL || lst->userdata2 != NULL) {
-        msg.userdata = lst->userdata;
-        msg.userdata2 = lst->userdata2;
-        msg.data = NULL; // this is a signal that the listener should clean up
-        lst->fn(tf, &msg); // return value is ignored here - use TF_STAY or TF_CLOSE
+    if (pool->class_count >= TF_RX_POOL_CLASSES) {
+        TF_Error("Too many RX pool classes");
+        return false;
     }
 
-    lst->fn = NULL; // Discard listener
-    lst->fn_timeout = NULL;
+    if (size < sizeof(uint8_t *)
+        || (pool->class_count > 0 && size <= pool->classes[pool->class_count - 1].size)) {
+        TF_Error("Bad RX pool class size %d", (int)size);
+        return false;
+    }
 
-    if (i == tf->count_id_lst - 1) {
-        tf->count_id_lst--;
+    // Link the buffers from the end, so they're handed out in order.
+    // The links may be unaligned, so they're copied byte-wise.
+    for (i = count; i > 0; i--) {
+        memcpy(storage + (uint32_t) (i - 1) * size, &next, sizeof(next));
+        next = storage + (uint32_t) (i - 1) * size;
     }
+
+    cls = &pool->classes[pool->class_count];
+    memset(cls, 0, sizeof(TF_RxPoolClass));
+    cls->free = next;
+    cls->size = size;
+    cls->count = count;
+
+    pool->class_count++;
+    return true;
 }
 
-/** Clean up Type listener */
-static inline void _TF_FN cleanup_type_listener(TinyFrame *tf, TF_COUNT i, struct TF_TypeListener_ *lst)
+/** Copy a class's counters */
+bool _TF_FN TF_RxPoolGetStats(TF_RxPool *pool, uint8_t class_index, TF_RxPoolClass *stats)
 {
-    lst->fn = NULL; // Discard listener
-    if (i == tf->count_type_lst - 1) {
-        tf->count_type_lst--;
-    }
+    if (class_index >= pool->class_count) return false;
+
+    RXPOOL_LOCK(pool);
+    *stats = pool->classes[class_index];
+    RXPOOL_UNLOCK(pool);
+    return true;
 }
 
-/** Clean up Generic listener */
-static inline void _TF_FN cleanup_generic_listener(TinyFrame *tf, TF_COUNT i, struct TF_GenericListener_ *lst)
+/** Take a buffer of at least 'len' bytes for the frame being received. Returns 1 on success. */
+static bool _TF_FN rxpool_take(TinyFrame *tf, TF_LEN len)
 {
-    lst->fn = NULL; // Discard listener
-    if (i == tf->count_generic_lst - 1) {
-        tf->count_generic_lst--;
+    TF_RxPool *pool = tf->rx_pool;
+    TF_RxPoolClass *cls;
+    bool counted = false;
+    uint8_t i;
+
+    if (pool == NULL) {
+        TF_Error("No RX pool set");
+        return false;
     }
-}
 
-/** Add a new ID listener. Returns 1 on success. */
-bool _TF_FN TF_AddIdListener(TinyFrame *tf, TF_Msg *msg, TF_Listener cb, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
-{
-    TF_COUNT i;
-    struct TF_IdListener_ *lst;
-    for (i = 0; i < TF_MAX_ID_LST; i++) {
-        lst = &tf->id_listeners[i];
-        // test for empty slot
-        if (lst->fn == NULL) {
-            lst->fn = cb;
-            lst->fn_timeout = ftimeout;
-            lst->id = msg->frame_id;
-            lst->userdata = msg->userdata;
-            lst->userdata2 = msg->userdata2;
-            lst->timeout_max = lst->timeout = timeout;
-            if (i >= tf->count_id_lst) {
-                tf->count_id_lst = (TF_COUNT) (i + 1);
-            }
-            return true;
+    RXPOOL_LOCK(pool);
+    for (i = 0; i < pool->class_count; i++) {
+        cls = &pool->classes[i];
+        if (cls->size < len) continue;
+
+        if (cls->free == NULL) {
+            // empty - try a bigger class. Count it only for the best fitting one.
+            if (!counted) cls->exhausted++;
+            counted = true;
+            continue;
+        }
+
+        tf->data = cls->free;
+        memcpy(&cls->free, cls->free, sizeof(cls->free));
+        tf->data_class = cls;
+        if (++cls->in_use > cls->peak) {
+            cls->peak = cls->in_use;
         }
+        RXPOOL_UNLOCK(pool);
+        return true;
     }
+    pool->failed++;
+    RXPOOL_UNLOCK(pool);
 
-    TF_Error("Failed to add ID listener");
+    TF_Error("No free RX buffer for %d bytes", (int)len);
     return false;
 }
 
-/** Add a new Type listener. Returns 1 on success. */
-bool _TF_FN TF_AddTypeListener(TinyFrame *tf, TF_TYPE frame_type, TF_Listener cb)
+/** Return a buffer to its class. NULL class = no buffer. */
+static void _TF_FN rxpool_give(TF_RxPool *pool, TF_RxPoolClass *cls, uint8_t *buf)
 {
-    TF_COUNT i;
-    struct TF_TypeListener_ *lst;
-    for (i = 0; i < TF_MAX_TYPE_LST; i++) {
-        lst = &tf->type_listeners[i];
-        // test for empty slot
-        if (lst->fn == NULL) {
-            lst->fn = cb;
-            lst->type = frame_type;
-            if (i >= tf->count_type_lst) {
-                tf->count_type_lst = (TF_COUNT) (i + 1);
-            }
-            return true;
-        }
-    }
+    if (cls == NULL) return;
 
-    TF_Error("Failed to add type listener");
-    return false;
+    RXPOOL_LOCK(pool);
+    memcpy(buf, &cls->free, sizeof(cls->free));
+    cls->free = buf;
+    cls->in_use--;
+    RXPOOL_UNLOCK(pool);
 }
 
-/** Add a new Generic listener. Returns 1 on success. */
-bool _TF_FN TF_AddGenericListener(TinyFrame *tf, TF_Listener cb)
+/** Return the RX buffer to the pool, if one is held */
+static void _TF_FN rxpool_release(TinyFrame *tf)
 {
-    TF_COUNT i;
-    struct TF_GenericListener_ *lst;
-    for (i = 0; i < TF_MAX_GEN_LST; i++) {
-        lst = &tf->generic_listeners[i];
-        // test for empty slot
-        if (lst->fn == NULL) {
-            lst->fn = cb;
-            if (i >= tf->count_generic_lst) {
-                tf->count_generic_lst = (TF_COUNT) (i + 1);
-            }
-            return true;
-        }
-    }
+    rxpool_give(tf->rx_pool, tf->data_class, tf->data);
+    tf->data = NULL;
+    tf->data_class = NULL;
+}
 
-    TF_Error("Failed to add generic listener");
-    return false;
+/** Set the pool an instance takes RX buffers from */
+void _TF_FN TF_SetRxPool(TinyFrame *tf, TF_RxPool *pool)
+{
+    rxpool_release(tf);
+    tf->rx_pool = pool;
 }
 
-/** Remove a ID listener by its frame ID. Returns 1 on success. */
-bool _TF_FN TF_RemoveIdListener(TinyFrame *tf, TF_ID frame_id)
+//endregion RX buffer pool
+#endif
+
+
+#if TF_USE_COMPRESSION
+//region Compression
+
+// Compressed payload: the message type, then LZF-style codes:
+//   000LLLLL                     - L + 1 literal bytes follow
+//   LLLOOOOO OOOOOOOO            - match of L + 2 bytes (L = 1..6), O + 1 bytes back
+//   111OOOOO LLLLLLLL OOOOOOOO   - match of L + 9 bytes
+#define TF_COMP_LIT_MAX   32
+#define TF_COMP_MATCH_MIN 3
+#define TF_COMP_MATCH_MAX (TF_COMP_MATCH_MIN + 6 + 255)
+#define TF_COMP_OFFSET_MAX 8192
+
+// Hash of the 3 bytes at p, TF_COMP_HASH_BITS wide
+#define TF_COMP_HASH(p) \
+    (uint16_t) ((((uint32_t) (p)[0] << 16 | (uint32_t) (p)[1] << 8 | (p)[2]) * 2654435761u) >> (32 - TF_COMP_HASH_BITS))
+
+/**
+ * Add a literal run to the output
+ *
+ * @return false if it doesn't fit
+ */
+static bool _TF_FN comp_literals(const uint8_t *in, uint32_t len, uint8_t *out, uint32_t *pos, uint32_t size)
 {
-    TF_COUNT i;
-    struct TF_IdListener_ *lst;
-    for (i = 0; i < tf->count_id_lst; i++) {
-        lst = &tf->id_listeners[i];
-        // test if live & matching
-        if (lst->fn != NULL && lst->id == frame_id) {
-            cleanup_id_listener(tf, i, lst);
-            return true;
-        }
+    uint32_t run;
+
+    while (len > 0) {
+        run = TF_MIN(len, TF_COMP_LIT_MAX);
+        if (*pos + 1 + run > size) return false;
+        out[(*pos)++] = (uint8_t) (run - 1);
+        memcpy(out + *pos, in, run);
+        *pos += run;
+        in += run;
+        len -= run;
     }
-
-    TF_Error("ID listener %d to remove not found", (int)frame_id);
-    return false;
+    return true;
 }
 
-/** Remove a type listener by its type. Returns 1 on success. */
-bool _TF_FN TF_RemoveTypeListener(TinyFrame *tf, TF_TYPE type)
+/**
+ * Compress a buffer
+ *
+ * @param tf - instance, holds the hash table
+ * @param in - data
+ * @param len - data length, at most TF_COMP_MAX_LEN
+ * @param out - output buffer
+ * @param size - output buffer size
+ * @return compressed length, 0 if it doesn't fit in the buffer
+ */
+static uint32_t _TF_FN comp_encode(TinyFrame *tf, const uint8_t *in, uint32_t len, uint8_t *out, uint32_t size)
 {
-    TF_COUNT i;
-    struct TF_TypeListener_ *lst;
-    for (i = 0; i < tf->count_type_lst; i++) {
-        lst = &tf->type_listeners[i];
-        // test if live & matching
-        if (lst->fn != NULL    && lst->type == type) {
-            cleanup_type_listener(tf, i, lst);
-            return true;
+    uint32_t ip = 0;
+    uint32_t lit = 0; // start of the pending literal run
+    uint32_t op = 0;
+    uint32_t ref, off, mlen, max;
+    uint16_t h;
+
+    // positions + 1, 0 = none
+    memset(tf->comp_hash, 0, sizeof(tf->comp_hash));
+
+    while (ip + TF_COMP_MATCH_MIN <= len) {
+        h = TF_COMP_HASH(in + ip);
+        ref = tf->comp_hash[h];
+        tf->comp_hash[h] = (uint16_t) (ip + 1);
+
+        if (ref == 0 || (off = ip - ref) >= TF_COMP_OFFSET_MAX
+            || in[ref - 1] != in[ip] || in[ref] != in[ip + 1] || in[ref + 1] != in[ip + 2]) {
+            ip++;
+            continue;
         }
+        ref--;
+
+        max = TF_MIN(len - ip, TF_COMP_MATCH_MAX);
+        mlen = TF_COMP_MATCH_MIN;
+        while (mlen < max && in[ref + mlen] == in[ip + mlen]) mlen++;
+
+        TF_TRY(comp_literals(in + lit, ip - lit, out, &op, size));
+        if (op + 3 > size) return 0;
+        if (mlen - 2 < 7) {
+            out[op++] = (uint8_t) (((mlen - 2) << 5) | (off >> 8));
+        } else {
+            out[op++] = (uint8_t) ((7 << 5) | (off >> 8));
+            out[op++] = (uint8_t) (mlen - 9);
+        }
+        out[op++] = (uint8_t) off;
+
+        ip += mlen;
+        lit = ip;
     }
 
-    TF_Error("Type listener %d to remove not found", (int)type);
-    return false;
+    TF_TRY(comp_literals(in + lit, len - lit, out, &op, size));
+    return op;
 }
 
-/** Remove a generic listener by its function pointer. Returns 1 on success. */
-bool _TF_FN TF_RemoveGenericListener(TinyFrame *tf, TF_Listener cb)
-{
-    TF_COUNT i;
+/**
+ * Decompress a buffer
+ *
+ * @param in - compressed data
+ * @param len - its length
+ * @param out - output buffer
+ * @param size - output buffer size
+ * @param outlen - decompressed length
+ * @return false if the data is corrupt or doesn't fit
+ */
+static bool _TF_FN comp_decode(const uint8_t *in, uint32_t len, uint8_t *out, uint32_t size, uint32_t *outlen)
+{
+    uint32_t ip = 0;
+    uint32_t op = 0;
+    uint32_t n, off;
+    uint8_t c;
+
+    while (ip < len) {
+        c = in[ip++];
+        n = c >> 5;
+
+        if (n == 0) {
+            n = (uint32_t) c + 1;
+            if (ip + n > len || op + n > size) return false;
+            memcpy(out + op, in + ip, n);
+            ip += n;
+            op += n;
+            continue;
+        }
+
+        if (n == 7) {
+            if (ip >= len) return false;
+            n += in[ip++];
+        }
+        n += 2;
+        if (ip >= len) return false;
+        off = (((uint32_t) c & 0x1F) << 8 | in[ip++]) + 1;
+        if (off > op || op + n > size) return false;
+
+        // may overlap, byte by byte
+        for (; n > 0; n--, op++) {
+            out[op] = out[op - off];
+        }
+    }
+
+    *outlen = op;
+    return true;
+}
+
+/**
+ * Compress a message to send, if it's worth it. Call with the Tx lock held.
+ *
+ * @param tf - instance
+ * @param msg - message to send
+ * @param packed - the compressed message, of type TF_COMP_TYPE
+ * @return true if compressed
+ */
+static bool _TF_FN comp_pack(TinyFrame *tf, TF_Msg *msg, TF_Msg *packed)
+{
+    uint32_t len;
+    int i;
+
+    if (msg->data == NULL || msg->len < TF_COMP_THRESHOLD || msg->len > TF_COMP_MAX_LEN) return false;
+
+    for (i = 0; i < TF_TYPE_BYTES; i++) {
+        tf->comp_tx[i] = (uint8_t) (msg->type >> ((TF_TYPE_BYTES - 1 - i) * 8));
+    }
+    // must come out shorter than the original
+    len = comp_encode(tf, msg->data, msg->len, tf->comp_tx + TF_TYPE_BYTES, msg->len - 1 - TF_TYPE_BYTES);
+    if (len == 0) return false;
+
+    *packed = *msg;
+    packed->type = TF_COMP_TYPE;
+    packed->data = tf->comp_tx;
+    packed->len = (TF_LEN) (TF_TYPE_BYTES + len);
+    return true;
+}
+
+/**
+ * Decompress a received message
+ *
+ * @param tf - instance
+ * @param msg - frame of type TF_COMP_TYPE, replaced by the original message
+ * @return success
+ */
+static bool _TF_FN comp_unpack(TinyFrame *tf, TF_Msg *msg)
+{
+    TF_TYPE type = 0;
+    uint32_t len;
+    int i;
+
+    if (msg->len < TF_TYPE_BYTES) return false;
+    for (i = 0; i < TF_TYPE_BYTES; i++) {
+        type = (TF_TYPE) ((type << 8) | msg->data[i]);
+    }
+
+    if (!comp_decode(msg->data + TF_TYPE_BYTES, msg->len - TF_TYPE_BYTES, tf->comp_rx, TF_COMP_MAX_LEN, &len)) {
+        TF_Error("Bad compressed message");
+        return false;
+    }
+
+    msg->type = type;
+    msg->data = tf->comp_rx;
+    msg->len = (TF_LEN) len;
+    return true;
+}
+
+//endregion Compression
+#endif
+
+
+//region Init
+
+/** Init with a user-allocated buffer */
+bool _TF_FN TF_InitStatic(TinyFrame *tf, TF_Peer peer_bit)
+{
+    if (tf == NULL) {
+        TF_Error("TF_InitStatic() failed, tf is null.");
+        return false;
+    }
+
+    // Zero it out, keeping user config
+    uint32_t usertag = tf->usertag;
+    void * userdata = tf->userdata;
+
+    memset(tf, 0, sizeof(struct TinyFrame_));
+
+    tf->usertag = usertag;
+    tf->userdata = userdata;
+
+    tf->peer_bit = peer_bit;
+
+#if TF_USE_FLOW_CONTROL
+    // the initial window is known to both peers
+    tf->flow_limit_frames = TF_FLOW_FRAMES;
+    tf->flow_limit_bytes = TF_FLOW_BYTES;
+    tf->flow_granted_frames = TF_FLOW_FRAMES;
+    tf->flow_granted_bytes = TF_FLOW_BYTES;
+#endif
+
+#if TF_USE_COBS
+    tf->cobs_pos = 1; // after the code of the first group
+    tf->cobs_sync = true; // the first frame may come without a delimiter before it
+#endif
+
+#if TF_USE_MPSC_TX
+    tf->mpsc_head = &tf->mpsc_stub;
+    tf->mpsc_tail = &tf->mpsc_stub;
+#endif
+
+#if TF_USE_TX_QUEUE && TF_TX_SCHED == TF_TX_SCHED_WEIGHTED
+    int c;
+    for (c = 0; c < TF_TX_PRIORITIES; c++) {
+        tf->txq[c].weight = 1;
+    }
+#endif
+
+    CKSUM_INIT();
+    return true;
+}
+
+/** Init with malloc */
+TinyFrame * _TF_FN TF_Init(TF_Peer peer_bit)
+{
+    TinyFrame *tf = malloc(sizeof(TinyFrame));
+    if (!tf) {
+        TF_Error("TF_Init() failed, out of memory.");
+        return NULL;
+    }
+
+    TF_InitStatic(tf, peer_bit);
+    return tf;
+}
+
+/** Release what the instance holds, keeping the struct */
+void _TF_FN TF_DeInitStatic(TinyFrame *tf)
+{
+    if (tf == NULL) return;
+#if TF_USE_RX_POOL
+    rxpool_release(tf);
+  #if TF_USE_RX_QUEUE
+    // return buffers of messages that were not dispatched
+    while (tf->rxq_tail != tf->rxq_head) {
+        rxpool_give(tf->rx_pool, tf->rxq[tf->rxq_tail].data_class, tf->rxq[tf->rxq_tail].data);
+        tf->rxq_tail = (uint16_t) (tf->rxq_tail + 1 == TF_RX_QUEUE_LEN ? 0 : tf->rxq_tail + 1);
+    }
+  #endif
+#endif
+#if TF_USE_DYNAMIC_LST
+    if (tf->id_listeners) TF_Free(tf, tf->id_listeners);
+    if (tf->type_listeners) TF_Free(tf, tf->type_listeners);
+    if (tf->generic_listeners) TF_Free(tf, tf->generic_listeners);
+    tf->id_listeners = NULL;
+    tf->type_listeners = NULL;
+    tf->generic_listeners = NULL;
+  #if TF_USE_ID_HASH
+    if (tf->id_hash) TF_Free(tf, tf->id_hash);
+    tf->id_hash = NULL;
+  #endif
+  #if TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_SORTED
+    if (tf->type_sorted) TF_Free(tf, tf->type_sorted);
+    tf->type_sorted = NULL;
+  #endif
+#endif
+}
+
+/** Release the struct */
+void TF_DeInit(TinyFrame *tf)
+{
+    if (tf == NULL) return;
+    TF_DeInitStatic(tf);
+    free(tf);
+}
+
+//endregion Init
+
+//region Listeners
+
+#if TF_USE_TIMER_WHEEL
+#define TF_WHEEL_MASK (TF_TIMER_WHEEL_SIZE - 1)
+
+// ID listener wheel_state
+#define TF_WHEEL_IDLE      0
+#define TF_WHEEL_SCHEDULED 1
+#define TF_WHEEL_EXPIRING  2
+
+/** Take an ID listener out of the timer wheel (also cancels a pending expiry in TF_Tick) */
+static void _TF_FN wheel_unlink(TinyFrame *tf, TF_COUNT slot)
+{
+    struct TF_IdListener_ *lst = &tf->id_listeners[slot];
+
+    if (lst->wheel_state == TF_WHEEL_SCHEDULED) {
+        if (lst->wheel_prev != 0) {
+            tf->id_listeners[lst->wheel_prev - 1].wheel_next = lst->wheel_next;
+        }
+        else {
+            tf->wheel[lst->deadline & TF_WHEEL_MASK] = lst->wheel_next;
+        }
+        if (lst->wheel_next != 0) {
+            tf->id_listeners[lst->wheel_next - 1].wheel_prev = lst->wheel_prev;
+        }
+    }
+    lst->wheel_state = TF_WHEEL_IDLE;
+}
+
+/** Put an ID listener in the timer wheel to expire after timeout_max ticks (if not 0) */
+static void _TF_FN wheel_schedule(TinyFrame *tf, TF_COUNT slot)
+{
+    struct TF_IdListener_ *lst = &tf->id_listeners[slot];
+    TF_COUNT *bucket;
+
+    wheel_unlink(tf, slot);
+    if (lst->timeout_max == 0) return;
+
+    lst->deadline = (TF_TICKS) (tf->ticks + lst->timeout_max);
+    bucket = &tf->wheel[lst->deadline & TF_WHEEL_MASK];
+
+    lst->wheel_prev = 0;
+    lst->wheel_next = *bucket;
+    if (*bucket != 0) {
+        tf->id_listeners[*bucket - 1].wheel_prev = (TF_COUNT) (slot + 1);
+    }
+    *bucket = (TF_COUNT) (slot + 1);
+    lst->wheel_state = TF_WHEEL_SCHEDULED;
+}
+#endif
+
+/** Reset ID listener's timeout to the original value */
+static inline void _TF_FN renew_id_listener(TinyFrame *tf, TF_COUNT i, struct TF_IdListener_ *lst)
+{
+    lst->timeout = lst->timeout_max;
+#if TF_USE_TIMER_WHEEL
+    wheel_schedule(tf, i);
+#else
+    (void)tf;
+    (void)i;
+#endif
+}
+
+#if TF_USE_ID_HASH
+#if TF_USE_DYNAMIC_LST
+#define TF_ID_HASH_MASK (tf->id_hash_mask)
+#else
+#define TF_ID_HASH_MASK ((uint32_t) (TF_ID_HASH_SIZE - 1))
+#endif
+
+/**
+ * Home position of a frame ID in the ID listener index - the top bits of a
+ * 32-bit multiplicative hash, as many as the index size needs
+ */
+static inline uint32_t _TF_FN id_hash_home(TinyFrame *tf, TF_ID id)
+{
+    uint32_t hash = (uint32_t) ((uint32_t) id * 0x9E3779B1UL);
+    return (uint32_t) (((uint64_t) hash * ((uint64_t) TF_ID_HASH_MASK + 1)) >> 32);
+}
+
+/** Add an ID listener slot to the index */
+static void _TF_FN id_hash_insert(TinyFrame *tf, TF_COUNT slot)
+{
+    uint32_t pos = id_hash_home(tf, tf->id_listeners[slot].id);
+
+    // there's always a free entry, the index is larger than the slot table
+    while (tf->id_hash[pos] != 0) {
+        pos = (pos + 1) & TF_ID_HASH_MASK;
+    }
+    tf->id_hash[pos] = (TF_COUNT) (slot + 1);
+}
+
+/** Remove an ID listener slot from the index */
+static void _TF_FN id_hash_remove(TinyFrame *tf, TF_COUNT slot)
+{
+    uint32_t pos = id_hash_home(tf, tf->id_listeners[slot].id);
+    uint32_t next, home;
+
+    while (tf->id_hash[pos] != (TF_COUNT) (slot + 1)) {
+        if (tf->id_hash[pos] == 0) return; // not indexed
+        pos = (pos + 1) & TF_ID_HASH_MASK;
+    }
+
+    // Move entries that follow back to the hole, so no lookup stops there early.
+    // An entry can move if the hole lies between its home position and the entry.
+    next = pos;
+    while (1) {
+        next = (next + 1) & TF_ID_HASH_MASK;
+        if (tf->id_hash[next] == 0) break;
+
+        home = id_hash_home(tf, tf->id_listeners[tf->id_hash[next] - 1].id);
+        if (((next - home) & TF_ID_HASH_MASK) >= ((next - pos) & TF_ID_HASH_MASK)) {
+            tf->id_hash[pos] = tf->id_hash[next];
+            pos = next;
+        }
+    }
+    tf->id_hash[pos] = 0;
+}
+
+/**
+ * Find the ID listener with the lowest slot number above 'after' (-1 = any)
+ * listening for a frame ID. This is the order in which the table scan would find them.
+ *
+ * @return slot number, or -1 if none
+ */
+static int32_t _TF_FN id_hash_find(TinyFrame *tf, TF_ID id, int32_t after)
+{
+    uint32_t pos;
+    int32_t found = -1;
+    int32_t slot;
+
+#if TF_USE_DYNAMIC_LST
+    if (tf->id_hash == NULL) return -1; // no listener was added yet
+#endif
+    pos = id_hash_home(tf, id);
+
+    // Listeners with the same ID are all in the same cluster, but not necessarily in slot order
+    while (tf->id_hash[pos] != 0) {
+        slot = tf->id_hash[pos] - 1;
+        if (slot > after && (found < 0 || slot < found) && tf->id_listeners[slot].id == id) {
+            found = slot;
+        }
+        pos = (pos + 1) & TF_ID_HASH_MASK;
+    }
+    return found;
+}
+
+#if TF_USE_DYNAMIC_LST
+/** Make the index twice as large as the ID listener table, or more */
+static bool _TF_FN id_hash_resize(TinyFrame *tf)
+{
+    uint32_t size = 2;
+    TF_COUNT *index;
+    TF_COUNT i;
+
+    while (size < 2u * tf->cap_id_lst) size <<= 1;
+
+    index = TF_Alloc(tf, size * (uint32_t) sizeof(TF_COUNT));
+    if (index == NULL) return false;
+    memset(index, 0, size * sizeof(TF_COUNT));
+
+    if (tf->id_hash != NULL) {
+        TF_Free(tf, tf->id_hash);
+    }
+    tf->id_hash = index;
+    tf->id_hash_mask = size - 1;
+
+    for (i = 0; i < tf->count_id_lst; i++) {
+        if (tf->id_listeners[i].fn != NULL) {
+            id_hash_insert(tf, i);
+        }
+    }
+    return true;
+}
+#endif
+#endif
+
+#if TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_SORTED
+/** Sort key of a type_sorted entry - (type, slot) pairs compared as one number */
+#define TF_TYPE_KEY(type, slot) (((uint64_t) (type) << 32) | (uint32_t) (slot))
+
+/** Position in type_sorted of the first listener ordered after (type, slot 'after') */
+static TF_COUNT _TF_FN type_sorted_bound(TinyFrame *tf, TF_TYPE type, int32_t after)
+{
+    const struct TF_TypeIndex_ *base = tf->type_sorted;
+    TF_COUNT n = tf->count_type_sorted;
+    TF_COUNT half;
+    uint64_t key = TF_TYPE_KEY(type, after + 1);
+
+    if (n == 0) return 0;
+
+    // Halve the range without branching on the comparison, it's not predictable
+    while (n > 1) {
+        half = (TF_COUNT) (n / 2);
+        base = (TF_TYPE_KEY(base[half].type, base[half].slot) < key) ? base + half : base;
+        n = (TF_COUNT) (n - half);
+    }
+    return (TF_COUNT) ((base - tf->type_sorted) + (TF_TYPE_KEY(base->type, base->slot) < key));
+}
+
+/** Add a Type listener slot to the lookup list */
+static void _TF_FN type_index_insert(TinyFrame *tf, TF_COUNT slot)
+{
+    TF_TYPE type = tf->type_listeners[slot].type;
+    TF_COUNT pos = type_sorted_bound(tf, type, slot);
+
+    memmove(&tf->type_sorted[pos + 1], &tf->type_sorted[pos], (tf->count_type_sorted - pos) * sizeof(struct TF_TypeIndex_));
+    tf->type_sorted[pos].type = type;
+    tf->type_sorted[pos].slot = slot;
+    tf->count_type_sorted++;
+}
+
+/** Remove a Type listener slot from the lookup list */
+static void _TF_FN type_index_remove(TinyFrame *tf, TF_COUNT slot)
+{
+    TF_COUNT pos = type_sorted_bound(tf, tf->type_listeners[slot].type, (int32_t) slot - 1);
+
+    if (pos == tf->count_type_sorted || tf->type_sorted[pos].slot != slot) return; // not listed
+
+    tf->count_type_sorted--;
+    memmove(&tf->type_sorted[pos], &tf->type_sorted[pos + 1], (tf->count_type_sorted - pos) * sizeof(struct TF_TypeIndex_));
+}
+
+/**
+ * Find the Type listener with the lowest slot number above 'after' (-1 = any)
+ * listening for a type.
+ *
+ * @return slot number, or -1 if none
+ */
+static int32_t _TF_FN type_index_find(TinyFrame *tf, TF_TYPE type, int32_t after)
+{
+    TF_COUNT pos = type_sorted_bound(tf, type, after);
+
+    if (pos == tf->count_type_sorted || tf->type_sorted[pos].type != type) return -1;
+    return tf->type_sorted[pos].slot;
+}
+
+#elif TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_DIRECT
+/** Find a live Type listener for a type in the table, starting at a slot number */
+static int32_t _TF_FN type_scan(TinyFrame *tf, TF_TYPE type, TF_COUNT from)
+{
+    TF_COUNT i;
+    for (i = from; i < tf->count_type_lst; i++) {
+        if (tf->type_listeners[i].fn && tf->type_listeners[i].type == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/** Add a Type listener slot to the lookup table */
+static void _TF_FN type_index_insert(TinyFrame *tf, TF_COUNT slot)
+{
+    TF_TYPE type = tf->type_listeners[slot].type;
+
+    if (tf->type_direct[type] == 0 || tf->type_direct[type] > slot + 1) {
+        tf->type_direct[type] = (TF_COUNT) (slot + 1);
+    }
+}
+
+/** Remove a Type listener slot from the lookup table */
+static void _TF_FN type_index_remove(TinyFrame *tf, TF_COUNT slot)
+{
+    TF_TYPE type = tf->type_listeners[slot].type;
+
+    if (tf->type_direct[type] == slot + 1) {
+        // pass it to the next listener for the type, if any
+        tf->type_direct[type] = (TF_COUNT) (type_scan(tf, type, (TF_COUNT) (slot + 1)) + 1);
+    }
+}
+
+/**
+ * Find the Type listener with the lowest slot number above 'after' (-1 = any)
+ * listening for a type. Only the first one is in the table - others are rare,
+ * they're found by a scan.
+ *
+ * @return slot number, or -1 if none
+ */
+static int32_t _TF_FN type_index_find(TinyFrame *tf, TF_TYPE type, int32_t after)
+{
+    if (after < 0) {
+        return (int32_t) tf->type_direct[type] - 1;
+    }
+    return type_scan(tf, type, (TF_COUNT) (after + 1));
+}
+#endif
+
+#if TF_USE_DYNAMIC_LST
+/**
+ * Grow a listener table (double it, up to 'max' slots) and put the new slots on its free list.
+ * The table is moved - pointers to listeners must be taken again after running user code.
+ */
+static bool _TF_FN lst_grow(TinyFrame *tf, void **table, TF_COUNT *cap, uint32_t max,
+                            TF_COUNT *free_head, uint32_t item_size, uint32_t link_offset)
+{
+    uint32_t new_cap = *cap ? 2u * *cap : TF_LST_INITIAL;
+    uint32_t i;
+    uint8_t *items;
+
+    if (*cap >= max) return false;
+    if (new_cap > max) new_cap = max;
+
+    items = TF_Alloc(tf, new_cap * item_size);
+    if (items == NULL) return false;
+
+    if (*table != NULL) {
+        memcpy(items, *table, *cap * item_size);
+        TF_Free(tf, *table);
+    }
+    memset(items + *cap * item_size, 0, (new_cap - *cap) * item_size);
+
+    // link the new slots, lowest first
+    for (i = new_cap; i > *cap; i--) {
+        *(TF_COUNT *) (items + (i - 1) * item_size + link_offset) = *free_head;
+        *free_head = (TF_COUNT) i;
+    }
+
+    *table = items;
+    *cap = (TF_COUNT) new_cap;
+    return true;
+}
+
+/** Make sure there's a free ID listener slot */
+static bool _TF_FN reserve_id_listener(TinyFrame *tf)
+{
+    if (tf->free_id_lst == 0) {
+        TF_TRY(lst_grow(tf, (void **) &tf->id_listeners, &tf->cap_id_lst, TF_MAX_ID_LST, &tf->free_id_lst,
+                        sizeof(struct TF_IdListener_), offsetof(struct TF_IdListener_, next_free)));
+    }
+#if TF_USE_ID_HASH
+    if (tf->id_hash == NULL || tf->id_hash_mask + 1 < 2u * tf->cap_id_lst) {
+        TF_TRY(id_hash_resize(tf));
+    }
+#endif
+    return true;
+}
+
+/** Make sure there's a free Type listener slot */
+static bool _TF_FN reserve_type_listener(TinyFrame *tf)
+{
+#if TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_SORTED
+    struct TF_TypeIndex_ *sorted;
+#endif
+
+    if (tf->free_type_lst == 0) {
+        TF_TRY(lst_grow(tf, (void **) &tf->type_listeners, &tf->cap_type_lst, TF_MAX_TYPE_LST, &tf->free_type_lst,
+                        sizeof(struct TF_TypeListener_), offsetof(struct TF_TypeListener_, next_free)));
+    }
+#if TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_SORTED
+    if (tf->cap_type_sorted < tf->cap_type_lst) {
+        sorted = TF_Alloc(tf, tf->cap_type_lst * (uint32_t) sizeof(struct TF_TypeIndex_));
+        if (sorted == NULL) return false;
+        if (tf->type_sorted != NULL) {
+            memcpy(sorted, tf->type_sorted, tf->count_type_sorted * sizeof(struct TF_TypeIndex_));
+            TF_Free(tf, tf->type_sorted);
+        }
+        tf->type_sorted = sorted;
+        tf->cap_type_sorted = tf->cap_type_lst;
+    }
+#endif
+    return true;
+}
+
+/** Make sure there's a free Generic listener slot */
+static bool _TF_FN reserve_generic_listener(TinyFrame *tf)
+{
+    if (tf->free_generic_lst == 0) {
+        TF_TRY(lst_grow(tf, (void **) &tf->generic_listeners, &tf->cap_generic_lst, TF_MAX_GEN_LST, &tf->free_generic_lst,
+                        sizeof(struct TF_GenericListener_), offsetof(struct TF_GenericListener_, next_free)));
+    }
+    return true;
+}
+#endif
+
+/** Notify callback about ID listener's demise & let it free any resources in userdata */
+static void _TF_FN cleanup_id_listener(TinyFrame *tf, TF_COUNT i, struct TF_IdListener_ *lst)
+{
+    TF_Msg msg;
+    if (lst->fn == NULL) return;
+
+    // Make user clean up their data - only if not NULL
+    if (lst->userdata != NULL || lst->userdata2 != NULL) {
+        msg.userdata = lst->userdata;
+        msg.userdata2 = lst->userdata2;
+        msg.data = NULL; // this is a signal that the listener should clean up
+        lst->fn(tf, &msg); // return value is ignored here - use TF_STAY or TF_CLOSE
+        lst = &tf->id_listeners[i]; // the table may have grown (moved) meanwhile
+    }
+
+#if TF_USE_ID_HASH
+    id_hash_remove(tf, i);
+#endif
+#if TF_USE_TIMER_WHEEL
+    wheel_unlink(tf, i);
+#endif
+    lst->fn = NULL; // Discard listener
+    lst->fn_timeout = NULL;
+#if TF_USE_FLOW_CONTROL
+    if (lst->query) tf->flow_queries--;
+#endif
+#if TF_USE_DYNAMIC_LST
+    lst->next_free = tf->free_id_lst;
+    tf->free_id_lst = (TF_COUNT) (i + 1);
+#endif
+
+    if (i == tf->count_id_lst - 1) {
+        tf->count_id_lst--;
+    }
+}
+
+/** Clean up Type listener */
+static inline void _TF_FN cleanup_type_listener(TinyFrame *tf, TF_COUNT i, struct TF_TypeListener_ *lst)
+{
+    if (lst->fn == NULL) return; // removed already
+#if TF_TYPE_DISPATCH != TF_TYPE_DISPATCH_LINEAR
+    type_index_remove(tf, i);
+#endif
+    lst->fn = NULL; // Discard listener
+#if TF_USE_DYNAMIC_LST
+    lst->next_free = tf->free_type_lst;
+    tf->free_type_lst = (TF_COUNT) (i + 1);
+#endif
+    if (i == tf->count_type_lst - 1) {
+        tf->count_type_lst--;
+    }
+}
+
+/** Clean up Generic listener */
+static inline void _TF_FN cleanup_generic_listener(TinyFrame *tf, TF_COUNT i, struct TF_GenericListener_ *lst)
+{
+    if (lst->fn == NULL) return; // removed already
+    lst->fn = NULL; // Discard listener
+#if TF_USE_DYNAMIC_LST
+    lst->next_free = tf->free_generic_lst;
+    tf->free_generic_lst = (TF_COUNT) (i + 1);
+#endif
+    if (i == tf->count_generic_lst - 1) {
+        tf->count_generic_lst--;
+    }
+}
+
+/**
+ * Add an ID listener
+ *
+ * @param query - added for a query sent by this instance (counted by flow control)
+ */
+static bool _TF_FN id_listener_add(TinyFrame *tf, TF_Msg *msg, TF_Listener cb, TF_Listener_Timeout ftimeout, TF_TICKS timeout, bool query)
+{
+    TF_COUNT i;
+    struct TF_IdListener_ *lst;
+
+#if TF_USE_DYNAMIC_LST
+    // take a free slot
+    if (!reserve_id_listener(tf)) {
+        TF_Error("Failed to add ID listener");
+        return false;
+    }
+    i = (TF_COUNT) (tf->free_id_lst - 1);
+    tf->free_id_lst = tf->id_listeners[i].next_free;
+#else
+    // find an empty slot
+    for (i = 0; i < TF_MAX_ID_LST; i++) {
+        if (tf->id_listeners[i].fn == NULL) break;
+    }
+    if (i == TF_MAX_ID_LST) {
+        TF_Error("Failed to add ID listener");
+        return false;
+    }
+#endif
+
+    lst = &tf->id_listeners[i];
+    lst->fn = cb;
+    lst->fn_timeout = ftimeout;
+    lst->id = msg->frame_id;
+    lst->userdata = msg->userdata;
+    lst->userdata2 = msg->userdata2;
+    lst->timeout_max = lst->timeout = timeout;
+#if TF_USE_FLOW_CONTROL
+    lst->query = query;
+    if (query) tf->flow_queries++;
+#else
+    (void) query;
+#endif
+    if (i >= tf->count_id_lst) {
+        tf->count_id_lst = (TF_COUNT) (i + 1);
+    }
+#if TF_USE_ID_HASH
+    id_hash_insert(tf, i);
+#endif
+#if TF_USE_TIMER_WHEEL
+    wheel_schedule(tf, i);
+#endif
+    return true;
+}
+
+bool _TF_FN TF_AddIdListener(TinyFrame *tf, TF_Msg *msg, TF_Listener cb, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    return id_listener_add(tf, msg, cb, ftimeout, timeout, false);
+}
+
+/** Add a new Type listener. Returns 1 on success. */
+bool _TF_FN TF_AddTypeListener(TinyFrame *tf, TF_TYPE frame_type, TF_Listener cb)
+{
+    TF_COUNT i;
+    struct TF_TypeListener_ *lst;
+
+#if TF_USE_DYNAMIC_LST
+    // take a free slot
+    if (!reserve_type_listener(tf)) {
+        TF_Error("Failed to add type listener");
+        return false;
+    }
+    i = (TF_COUNT) (tf->free_type_lst - 1);
+    tf->free_type_lst = tf->type_listeners[i].next_free;
+#else
+    // find an empty slot
+    for (i = 0; i < TF_MAX_TYPE_LST; i++) {
+        if (tf->type_listeners[i].fn == NULL) break;
+    }
+    if (i == TF_MAX_TYPE_LST) {
+        TF_Error("Failed to add type listener");
+        return false;
+    }
+#endif
+
+    lst = &tf->type_listeners[i];
+    lst->fn = cb;
+    lst->type = frame_type;
+    if (i >= tf->count_type_lst) {
+        tf->count_type_lst = (TF_COUNT) (i + 1);
+    }
+#if TF_TYPE_DISPATCH != TF_TYPE_DISPATCH_LINEAR
+    type_index_insert(tf, i);
+#endif
+    return true;
+}
+
+/** Add a new Generic listener. Returns 1 on success. */
+bool _TF_FN TF_AddGenericListener(TinyFrame *tf, TF_Listener cb)
+{
+    TF_COUNT i;
+    struct TF_GenericListener_ *lst;
+
+#if TF_USE_DYNAMIC_LST
+    // take a free slot
+    if (!reserve_generic_listener(tf)) {
+        TF_Error("Failed to add generic listener");
+        return false;
+    }
+    i = (TF_COUNT) (tf->free_generic_lst - 1);
+    tf->free_generic_lst = tf->generic_listeners[i].next_free;
+#else
+    // find an empty slot
+    for (i = 0; i < TF_MAX_GEN_LST; i++) {
+        if (tf->generic_listeners[i].fn == NULL) break;
+    }
+    if (i == TF_MAX_GEN_LST) {
+        TF_Error("Failed to add generic listener");
+        return false;
+    }
+#endif
+
+    lst = &tf->generic_listeners[i];
+    lst->fn = cb;
+    if (i >= tf->count_generic_lst) {
+        tf->count_generic_lst = (TF_COUNT) (i + 1);
+    }
+    return true;
+}
+
+/** Remove a ID listener by its frame ID. Returns 1 on success. */
+bool _TF_FN TF_RemoveIdListener(TinyFrame *tf, TF_ID frame_id)
+{
+    TF_COUNT i;
+    struct TF_IdListener_ *lst;
+#if TF_USE_ID_HASH
+    int32_t slot = id_hash_find(tf, frame_id, -1);
+    if (slot >= 0) {
+        i = (TF_COUNT) slot;
+        lst = &tf->id_listeners[i];
+        cleanup_id_listener(tf, i, lst);
+        return true;
+    }
+#else
+    for (i = 0; i < tf->count_id_lst; i++) {
+        lst = &tf->id_listeners[i];
+        // test if live & matching
+        if (lst->fn != NULL && lst->id == frame_id) {
+            cleanup_id_listener(tf, i, lst);
+            return true;
+        }
+    }
+#endif
+
+    TF_Error("ID listener %d to remove not found", (int)frame_id);
+    return false;
+}
+
+/** Remove a type listener by its type. Returns 1 on success. */
+bool _TF_FN TF_RemoveTypeListener(TinyFrame *tf, TF_TYPE type)
+{
+    TF_COUNT i;
+    struct TF_TypeListener_ *lst;
+#if TF_TYPE_DISPATCH != TF_TYPE_DISPATCH_LINEAR
+    int32_t slot = type_index_find(tf, type, -1);
+    if (slot >= 0) {
+        i = (TF_COUNT) slot;
+        lst = &tf->type_listeners[i];
+        cleanup_type_listener(tf, i, lst);
+        return true;
+    }
+#else
+    for (i = 0; i < tf->count_type_lst; i++) {
+        lst = &tf->type_listeners[i];
+        // test if live & matching
+        if (lst->fn != NULL    && lst->type == type) {
+            cleanup_type_listener(tf, i, lst);
+            return true;
+        }
+    }
+#endif
+
+    TF_Error("Type listener %d to remove not found", (int)type);
+    return false;
+}
+
+/** Remove a generic listener by its function pointer. Returns 1 on success. */
+bool _TF_FN TF_RemoveGenericListener(TinyFrame *tf, TF_Listener cb)
+{
+    TF_COUNT i;
     struct TF_GenericListener_ *lst;
     for (i = 0; i < tf->count_generic_lst; i++) {
         lst = &tf->generic_listeners[i];
@@ -425,118 +1629,920 @@ bool _TF_FN TF_RemoveGenericListener(TinyFrame *tf, TF_Listener cb)
     return false;
 }
 
-/** Handle a message that was just collected & verified by the parser */
-static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
-{
-    TF_COUNT i;
-    struct TF_IdListener_ *ilst;
-    struct TF_TypeListener_ *tlst;
-    struct TF_GenericListener_ *glst;
-    TF_Result res;
+#if TF_USE_STREAM_RX
+
+/** Clean up Stream listener */
+static inline void _TF_FN cleanup_stream_listener(TinyFrame *tf, TF_COUNT i, struct TF_StreamListener_ *lst)
+{
+    lst->fn = NULL; // Discard listener
+    if (i == tf->count_stream_lst - 1) {
+        tf->count_stream_lst--;
+    }
+}
+
+/** Add a new Stream listener. Returns 1 on success. */
+bool _TF_FN TF_AddStreamListener(TinyFrame *tf, TF_TYPE frame_type, TF_StreamListener cb)
+{
+    TF_COUNT i;
+    struct TF_StreamListener_ *lst;
+    for (i = 0; i < TF_MAX_STREAM_LST; i++) {
+        lst = &tf->stream_listeners[i];
+        // test for empty slot
+        if (lst->fn == NULL) {
+            lst->fn = cb;
+            lst->type = frame_type;
+            if (i >= tf->count_stream_lst) {
+                tf->count_stream_lst = (TF_COUNT) (i + 1);
+            }
+            return true;
+        }
+    }
+
+    TF_Error("Failed to add stream listener");
+    return false;
+}
+
+/** Remove a stream listener by its type. Returns 1 on success. */
+bool _TF_FN TF_RemoveStreamListener(TinyFrame *tf, TF_TYPE type)
+{
+    TF_COUNT i;
+    struct TF_StreamListener_ *lst;
+    for (i = 0; i < tf->count_stream_lst; i++) {
+        lst = &tf->stream_listeners[i];
+        // test if live & matching
+        if (lst->fn != NULL && lst->type == type) {
+            cleanup_stream_listener(tf, i, lst);
+            return true;
+        }
+    }
+
+    TF_Error("Stream listener %d to remove not found", (int)type);
+    return false;
+}
+
+/** Find the stream listener for a frame type, or NULL */
+static TF_StreamListener _TF_FN TF_FindStreamListener(TinyFrame *tf, TF_TYPE type)
+{
+    TF_COUNT i;
+    struct TF_StreamListener_ *lst;
+    for (i = 0; i < tf->count_stream_lst; i++) {
+        lst = &tf->stream_listeners[i];
+        if (lst->fn != NULL && lst->type == type) {
+            return lst->fn;
+        }
+    }
+    return NULL;
+}
+
+#endif
+
+/** Pass a received message to the listeners */
+static void _TF_FN TF_DispatchMessage(TinyFrame *tf, TF_Msg *msg)
+{
+    TF_COUNT i;
+    struct TF_IdListener_ *ilst;
+    struct TF_TypeListener_ *tlst;
+    struct TF_GenericListener_ *glst;
+    TF_Result res;
+#if TF_USE_ID_HASH || TF_TYPE_DISPATCH != TF_TYPE_DISPATCH_LINEAR
+    int32_t slot;
+#endif
+
+    // Any listener can consume the message, or let someone else handle it.
+
+    // The loop upper bounds are the highest currently used slot index
+    // (or close to it, depending on the order of listener removals).
+
+    // ID listeners first
+#if TF_USE_ID_HASH
+    for (slot = id_hash_find(tf, msg->frame_id, -1); slot >= 0; slot = id_hash_find(tf, msg->frame_id, slot)) {
+        i = (TF_COUNT) slot;
+        ilst = &tf->id_listeners[i];
+#else
+    for (i = 0; i < tf->count_id_lst; i++) {
+        ilst = &tf->id_listeners[i];
+#endif
+
+        if (ilst->fn && ilst->id == msg->frame_id) {
+            msg->userdata = ilst->userdata; // pass userdata pointer to the callback
+            msg->userdata2 = ilst->userdata2;
+            res = ilst->fn(tf, msg);
+            ilst = &tf->id_listeners[i]; // the table may have grown (moved) meanwhile
+            ilst->userdata = msg->userdata; // put it back (may have changed the pointer or set to NULL)
+            ilst->userdata2 = msg->userdata2; // put it back (may have changed the pointer or set to NULL)
+
+            if (res != TF_NEXT) {
+                // if it's TF_CLOSE, we assume user already cleaned up userdata
+                if (res == TF_RENEW) {
+                    renew_id_listener(tf, i, ilst);
+                }
+                else if (res == TF_CLOSE) {
+                    // Set userdata to NULL to avoid calling user for cleanup
+                    ilst->userdata = NULL;
+                    ilst->userdata2 = NULL;
+                    cleanup_id_listener(tf, i, ilst);
+                }
+                return;
+            }
+        }
+    }
+    // clean up for the following listeners that don't use userdata (this avoids data from
+    // an ID listener that returned TF_NEXT from leaking into Type and Generic listeners)
+    msg->userdata = NULL;
+    msg->userdata2 = NULL;
+
+    // Type listeners
+#if TF_TYPE_DISPATCH != TF_TYPE_DISPATCH_LINEAR
+    for (slot = type_index_find(tf, msg->type, -1); slot >= 0; slot = type_index_find(tf, msg->type, slot)) {
+        i = (TF_COUNT) slot;
+        tlst = &tf->type_listeners[i];
+#else
+    for (i = 0; i < tf->count_type_lst; i++) {
+        tlst = &tf->type_listeners[i];
+#endif
+
+        if (tlst->fn && tlst->type == msg->type) {
+            res = tlst->fn(tf, msg);
+            tlst = &tf->type_listeners[i]; // the table may have grown (moved) meanwhile
+
+            if (res != TF_NEXT) {
+                // type listeners don't have userdata.
+                // TF_RENEW doesn't make sense here because type listeners don't expire = same as TF_STAY
+
+                if (res == TF_CLOSE) {
+                    cleanup_type_listener(tf, i, tlst);
+                }
+                return;
+            }
+        }
+    }
+
+    // Generic listeners
+    for (i = 0; i < tf->count_generic_lst; i++) {
+        glst = &tf->generic_listeners[i];
+
+        if (glst->fn) {
+            res = glst->fn(tf, msg);
+            glst = &tf->generic_listeners[i]; // the table may have grown (moved) meanwhile
+
+            if (res != TF_NEXT) {
+                // generic listeners don't have userdata.
+                // TF_RENEW doesn't make sense here because generic listeners don't expire = same as TF_STAY
+
+                // note: It's not expected that user will have multiple generic listeners, or
+                // ever actually remove them. They're most useful as default callbacks if no other listener
+                // handled the message.
+
+                if (res == TF_CLOSE) {
+                    cleanup_generic_listener(tf, i, glst);
+                }
+                return;
+            }
+        }
+    }
+
+    TF_Error("Unhandled message, type %d", (int)msg->type);
+}
+
+#if TF_USE_FLOW_CONTROL
+//region Flow control
+
+// Credit frame payload: kind, then frame and byte counters (uint32 each)
+#define TF_FLOW_GRANT 0 // receiver -> sender: credit limits
+#define TF_FLOW_PROBE 1 // sender -> receiver: totals sent so far, asking for credit
+#define TF_FLOW_MSG_LEN 9
+
+/**
+ * Send a credit frame
+ *
+ * @param tf - instance
+ * @param kind - TF_FLOW_GRANT or TF_FLOW_PROBE
+ * @param frames - frame counter
+ * @param bytes - byte counter
+ * @return success
+ */
+static bool _TF_FN flow_send(TinyFrame *tf, uint8_t kind, uint32_t frames, uint32_t bytes)
+{
+    uint8_t buf[TF_FLOW_MSG_LEN];
+    int i;
+
+    buf[0] = kind;
+    for (i = 0; i < 4; i++) {
+        buf[1 + i] = (uint8_t) (frames >> (24 - i * 8));
+        buf[5 + i] = (uint8_t) (bytes >> (24 - i * 8));
+    }
+    return TF_SendSimple(tf, TF_FLOW_TYPE, buf, TF_FLOW_MSG_LEN);
+}
+
+/**
+ * Count received frames that are not handled yet - they still hold their buffers
+ *
+ * @param tf - instance
+ * @param frames - nr of frames
+ * @param bytes - their payload bytes
+ */
+static void _TF_FN flow_pending(TinyFrame *tf, uint32_t *frames, uint32_t *bytes)
+{
+    *frames = 0;
+    *bytes = 0;
+#if TF_USE_RX_QUEUE
+    uint16_t i;
+    for (i = tf->rxq_tail; i != TF_ATOMIC_LOAD(&tf->rxq_head); i = (uint16_t) (i + 1 == TF_RX_QUEUE_LEN ? 0 : i + 1)) {
+        if (tf->rxq[i].type == TF_FLOW_TYPE) continue; // probes use no credit
+        (*frames)++;
+        *bytes += tf->rxq[i].len;
+    }
+#else
+    (void) tf; // frames are handled as soon as they arrive
+#endif
+}
+
+/**
+ * Send new credit limits to the peer, if they grew enough since the last grant
+ * (by half the window), or always if forced.
+ *
+ * @param tf - instance
+ * @param force - send even if little changed
+ * @return false if the grant couldn't be sent
+ */
+static bool _TF_FN flow_grant(TinyFrame *tf, bool force)
+{
+    uint32_t frames, bytes;
+
+    flow_pending(tf, &frames, &bytes);
+    frames = tf->flow_rx_frames + TF_FLOW_FRAMES - frames;
+    bytes = tf->flow_rx_bytes + TF_FLOW_BYTES - bytes;
+
+    if (!force
+        && (int32_t) (frames - tf->flow_granted_frames) < (TF_FLOW_FRAMES + 1) / 2
+        && (TF_FLOW_BYTES == 0 || (int32_t) (bytes - tf->flow_granted_bytes) < (TF_FLOW_BYTES + 1) / 2)) {
+        return true;
+    }
+
+    // if it can't be sent now, it's tried again after the next frame
+    TF_TRY(flow_send(tf, TF_FLOW_GRANT, frames, bytes));
+    tf->flow_granted_frames = frames;
+    tf->flow_granted_bytes = bytes;
+    return true;
+}
+
+/**
+ * A received frame was handled, its buffer is free again
+ *
+ * @param tf - instance
+ * @param len - payload length
+ */
+static void _TF_FN flow_consumed(TinyFrame *tf, TF_LEN len)
+{
+    tf->flow_rx_frames++;
+    tf->flow_rx_bytes += len;
+    flow_grant(tf, false);
+}
+
+/**
+ * Handle a received credit frame
+ *
+ * @param tf - instance
+ * @param msg - the frame
+ */
+static void _TF_FN flow_receive(TinyFrame *tf, TF_Msg *msg)
+{
+    uint32_t frames = 0;
+    uint32_t bytes = 0;
+    uint32_t sent_frames, sent_bytes;
+    int i;
+
+    if (msg->len != TF_FLOW_MSG_LEN) return;
+    for (i = 0; i < 4; i++) {
+        frames = (frames << 8) | msg->data[1 + i];
+        bytes = (bytes << 8) | msg->data[5 + i];
+    }
+
+    if (msg->data[0] == TF_FLOW_PROBE) {
+        // Frames are handled in order, so everything the peer sent before the probe was
+        // handled or lost on the way - count the lost frames as handled so their credit
+        // isn't lost too
+        tf->flow_rx_frames = frames;
+        tf->flow_rx_bytes = bytes;
+        flow_grant(tf, true);
+        return;
+    }
+
+    // Never more than the window - the counters may disagree after a peer restarts
+    // This runs in the receiving thread, the sending side may be in another
+    sent_frames = TF_ATOMIC_LOAD(&tf->flow_tx_frames);
+    sent_bytes = TF_ATOMIC_LOAD(&tf->flow_tx_bytes);
+    if ((int32_t) (frames - sent_frames) > TF_FLOW_FRAMES) {
+        frames = sent_frames + TF_FLOW_FRAMES;
+    }
+    if ((int32_t) (bytes - sent_bytes) > TF_FLOW_BYTES) {
+        bytes = sent_bytes + TF_FLOW_BYTES;
+    }
+    TF_ATOMIC_STORE(&tf->flow_limit_frames, frames);
+    TF_ATOMIC_STORE(&tf->flow_limit_bytes, bytes);
+    TF_ATOMIC_STORE(&tf->flow_blocked, false);
+}
+
+/**
+ * Check if a frame can be sent now
+ *
+ * @param tf - instance
+ * @param len - payload length
+ * @param query - it's a query, adding an ID listener
+ * @return true if there's credit for it
+ */
+static bool _TF_FN flow_check(TinyFrame *tf, TF_LEN len, bool query)
+{
+    if (query && TF_FLOW_QUERIES > 0 && tf->flow_queries >= TF_FLOW_QUERIES) {
+        TF_Error("Too many queries waiting for a response");
+        return false;
+    }
+
+    if ((int32_t) (TF_ATOMIC_LOAD(&tf->flow_limit_frames) - tf->flow_tx_frames) <= 0
+        || (TF_FLOW_BYTES > 0 && (int32_t) (TF_ATOMIC_LOAD(&tf->flow_limit_bytes) - tf->flow_tx_bytes) < (int32_t) len)) {
+        // if a grant comes in meanwhile, this only costs an extra probe
+        if (!TF_ATOMIC_LOAD(&tf->flow_blocked)) {
+            tf->flow_probe_ticks = 0;
+            TF_ATOMIC_STORE(&tf->flow_blocked, true);
+        }
+        TF_Error("No credit to send");
+        return false;
+    }
+    return true;
+}
+
+/** Get the nr of frames that can be sent now */
+uint32_t _TF_FN TF_FlowCredit(TinyFrame *tf)
+{
+    int32_t credit = (int32_t) (TF_ATOMIC_LOAD(&tf->flow_limit_frames) - tf->flow_tx_frames);
+    return credit > 0 ? (uint32_t) credit : 0;
+}
+
+/** Send the current credit to the peer */
+bool _TF_FN TF_FlowUpdate(TinyFrame *tf)
+{
+    return flow_grant(tf, true);
+}
+
+//endregion Flow control
+#endif
+
+#if TF_USE_FRAGMENTS
+//region Fragment reassembly
+
+// Fragment payload: flags byte, then the message type and length in the first fragment, then data
+#define TF_FRAG_FIRST 0x01
+#define TF_FRAG_LAST  0x02
+#define TF_FRAG_HEAD_LEN (1 + TF_TYPE_BYTES + TF_LEN_BYTES)
+
+/**
+ * Find the reassembly buffer of a fragmented message
+ *
+ * @param tf - instance
+ * @param id - frame ID of the message
+ * @return the buffer, NULL if none
+ */
+static struct TF_FragRx_ * _TF_FN frag_rx_find(TinyFrame *tf, TF_ID id)
+{
+    TF_COUNT i;
+    for (i = 0; i < TF_MAX_FRAG_RX; i++) {
+        if (tf->frag_rx[i].used && tf->frag_rx[i].id == id) return &tf->frag_rx[i];
+    }
+    return NULL;
+}
+
+/**
+ * Get a reassembly buffer for a new fragmented message. If all are used,
+ * the one that waited the longest for a fragment is dropped.
+ *
+ * @param tf - instance
+ * @return the buffer
+ */
+static struct TF_FragRx_ * _TF_FN frag_rx_take(TinyFrame *tf)
+{
+    struct TF_FragRx_ *oldest = &tf->frag_rx[0];
+    TF_COUNT i;
+
+    for (i = 0; i < TF_MAX_FRAG_RX; i++) {
+        if (!tf->frag_rx[i].used) return &tf->frag_rx[i];
+        if ((int32_t) (tf->frag_rx[i].stamp - oldest->stamp) < 0) oldest = &tf->frag_rx[i];
+    }
+
+    TF_Error("Fragmented message %d dropped, no free buffer", (int)oldest->id);
+    return oldest;
+}
+
+/**
+ * Add a received fragment to its message, pass the message to the listeners when complete
+ *
+ * @param tf - instance
+ * @param msg - the fragment frame
+ */
+static void _TF_FN frag_rx_accept(TinyFrame *tf, TF_Msg *msg)
+{
+    struct TF_FragRx_ *fr;
+    const uint8_t *data = msg->data;
+    TF_LEN len = msg->len;
+    uint8_t flags;
+    TF_Msg whole;
+    int i;
+
+    if (len < 1) return;
+    flags = *data++;
+    len--;
+
+    fr = frag_rx_find(tf, msg->frame_id);
+
+    if (flags & TF_FRAG_FIRST) {
+        if (len < TF_TYPE_BYTES + TF_LEN_BYTES) return;
+        if (fr == NULL) fr = frag_rx_take(tf);
+
+        fr->used = true;
+        fr->id = msg->frame_id;
+        fr->type = 0;
+        fr->len = 0;
+        fr->received = 0;
+        for (i = 0; i < TF_TYPE_BYTES; i++) fr->type = (TF_TYPE) ((fr->type << 8) | *data++);
+        for (i = 0; i < TF_LEN_BYTES; i++) fr->len = (TF_LEN) ((fr->len << 8) | *data++);
+        len = (TF_LEN) (len - TF_TYPE_BYTES - TF_LEN_BYTES);
+
+        if (fr->len > TF_FRAG_MAX_LEN) {
+            TF_Error("Fragmented message too long: %d", (int)fr->len);
+            fr->used = false;
+            return;
+        }
+    }
+    else if (fr == NULL) {
+        TF_Error("Fragment of unknown message %d", (int)msg->frame_id);
+        return;
+    }
+
+    if (len > fr->len - fr->received) {
+        TF_Error("Fragmented message %d longer than announced", (int)fr->id);
+        fr->used = false;
+        return;
+    }
+    memcpy(fr->data + fr->received, data, len);
+    fr->received += len;
+    fr->stamp = tf->frag_stamp++;
+
+    if (flags & TF_FRAG_LAST) {
+        if (fr->received != fr->len) {
+            TF_Error("Fragmented message %d incomplete", (int)fr->id);
+            fr->used = false;
+            return;
+        }
+
+        TF_ClearMsg(&whole);
+        whole.frame_id = fr->id;
+        whole.is_response = false;
+        whole.type = fr->type;
+        whole.data = fr->data;
+        whole.len = fr->len;
+        TF_DispatchMessage(tf, &whole);
+
+        fr->used = false;
+    }
+}
+
+//endregion Fragment reassembly
+#endif
+
+#if TF_USE_RELIABLE
+//region Reliable delivery
+
+// Reliable frame payload: kind, then
+//   TF_REL_DATA - sequence nr, oldest sequence nr the sender still has (uint16 each), message type, data
+//   TF_REL_ACK  - next sequence nr expected (uint16), bitmap of the ones after it that came early (uint32)
+#define TF_REL_DATA 0
+#define TF_REL_ACK  1
+#define TF_REL_HEAD_LEN (5 + TF_TYPE_BYTES)
+#define TF_REL_ACK_LEN 7
+
+// Slot of a sequence nr in the sender's and receiver's windows
+#define TF_REL_SLOT(seq) ((uint16_t) (seq) & (TF_REL_WINDOW - 1))
 
-    // Prepare message object
+/**
+ * Pass a message to the listeners
+ *
+ * @param tf - instance
+ * @param id - ID of the frame it came in
+ * @param type - message type
+ * @param data - payload
+ * @param len - payload length
+ */
+static void _TF_FN rel_deliver(TinyFrame *tf, TF_ID id, TF_TYPE type, const uint8_t *data, TF_LEN len)
+{
     TF_Msg msg;
+
     TF_ClearMsg(&msg);
-    msg.frame_id = tf->id;
+    msg.frame_id = id;
     msg.is_response = false;
-    msg.type = tf->type;
-    msg.data = tf->data;
-    msg.len = tf->len;
+    msg.type = type;
+    msg.data = data;
+    msg.len = len;
+    TF_DispatchMessage(tf, &msg);
+}
 
-    // Any listener can consume the message, or let someone else handle it.
+/**
+ * Acknowledge the received messages. If it can't be sent now, it's tried again on the next tick.
+ *
+ * @param tf - instance
+ * @return success
+ */
+static bool _TF_FN rel_ack(TinyFrame *tf)
+{
+    uint8_t buf[TF_REL_ACK_LEN];
+    uint32_t bits = 0;
+    uint16_t seq;
+    struct TF_RelRx_ *slot;
+    int i;
+
+    for (i = 1; i < TF_REL_WINDOW; i++) {
+        seq = (uint16_t) (tf->rel_rx_next + i);
+        slot = &tf->rel_rx[TF_REL_SLOT(seq)];
+        if (slot->used && slot->seq == seq) bits |= (uint32_t) 1 << (i - 1);
+    }
 
-    // The loop upper bounds are the highest currently used slot index
-    // (or close to it, depending on the order of listener removals).
+    buf[0] = TF_REL_ACK;
+    buf[1] = (uint8_t) (tf->rel_rx_next >> 8);
+    buf[2] = (uint8_t) tf->rel_rx_next;
+    for (i = 0; i < 4; i++) {
+        buf[3 + i] = (uint8_t) (bits >> (24 - i * 8));
+    }
 
-    // ID listeners first
-    for (i = 0; i < tf->count_id_lst; i++) {
-        ilst = &tf->id_listeners[i];
+    tf->rel_ack_due = true;
+    TF_TRY(TF_SendSimple(tf, TF_REL_TYPE, buf, TF_REL_ACK_LEN));
+    tf->rel_ack_due = false;
+    tf->rel_rx_unacked = 0;
+    return true;
+}
 
-        if (ilst->fn && ilst->id == msg.frame_id) {
-            msg.userdata = ilst->userdata; // pass userdata pointer to the callback
-            msg.userdata2 = ilst->userdata2;
-            res = ilst->fn(tf, &msg);
-            ilst->userdata = msg.userdata; // put it back (may have changed the pointer or set to NULL)
-            ilst->userdata2 = msg.userdata2; // put it back (may have changed the pointer or set to NULL)
+/**
+ * Pass on the buffered messages that are next in order
+ *
+ * @param tf - instance
+ */
+static void _TF_FN rel_rx_flush(TinyFrame *tf)
+{
+    struct TF_RelRx_ *slot;
+    uint16_t seq;
 
-            if (res != TF_NEXT) {
-                // if it's TF_CLOSE, we assume user already cleaned up userdata
-                if (res == TF_RENEW) {
-                    renew_id_listener(ilst);
-                }
-                else if (res == TF_CLOSE) {
-                    // Set userdata to NULL to avoid calling user for cleanup
-                    ilst->userdata = NULL;
-                    ilst->userdata2 = NULL;
-                    cleanup_id_listener(tf, i, ilst);
-                }
-                return;
+    for (;;) {
+        seq = tf->rel_rx_next;
+        slot = &tf->rel_rx[TF_REL_SLOT(seq)];
+        if (!slot->used || slot->seq != seq) return;
+
+        tf->rel_rx_next++;
+        rel_deliver(tf, slot->frame_id, slot->type, slot->data, slot->len);
+        slot->used = false;
+    }
+}
+
+/**
+ * Move the receive window to the oldest message the sender still has - it gave up
+ * on the ones before. Messages received after a lost one are passed on.
+ *
+ * @param tf - instance
+ * @param base - the sender's oldest sequence nr
+ */
+static void _TF_FN rel_rx_skip(TinyFrame *tf, uint16_t base)
+{
+    int16_t gap = (int16_t) (base - tf->rel_rx_next);
+    struct TF_RelRx_ *slot;
+    uint16_t seq;
+    int i;
+
+    if (gap >= -TF_REL_WINDOW && gap <= 0) return; // the usual case
+
+    if (gap < 0) {
+        // the sender can't be this far behind unless it restarted
+        TF_Error("Reliable link restarted by the peer");
+        for (i = 0; i < TF_REL_WINDOW; i++) {
+            tf->rel_rx[i].used = false;
+        }
+    }
+    else {
+        TF_Error("Reliable messages before %d lost", (int)base);
+        for (i = 0; i < TF_REL_WINDOW && tf->rel_rx_next != base; i++) {
+            seq = tf->rel_rx_next++;
+            slot = &tf->rel_rx[TF_REL_SLOT(seq)];
+            if (slot->used && slot->seq == seq) {
+                rel_deliver(tf, slot->frame_id, slot->type, slot->data, slot->len);
+                slot->used = false;
             }
         }
     }
-    // clean up for the following listeners that don't use userdata (this avoids data from
-    // an ID listener that returned TF_NEXT from leaking into Type and Generic listeners)
-    msg.userdata = NULL;
-    msg.userdata2 = NULL;
 
-    // Type listeners
-    for (i = 0; i < tf->count_type_lst; i++) {
-        tlst = &tf->type_listeners[i];
+    tf->rel_rx_next = base;
+    rel_rx_flush(tf);
+}
 
-        if (tlst->fn && tlst->type == msg.type) {
-            res = tlst->fn(tf, &msg);
+/**
+ * Release sent messages from the start of the window that were acknowledged
+ * or given up on, calling their callbacks
+ *
+ * @param tf - instance
+ */
+static void _TF_FN rel_tx_release(TinyFrame *tf)
+{
+    struct TF_RelTx_ *slot;
+    TF_Msg msg;
 
-            if (res != TF_NEXT) {
-                // type listeners don't have userdata.
-                // TF_RENEW doesn't make sense here because type listeners don't expire = same as TF_STAY
+    while (tf->rel_tx_base != tf->rel_tx_next) {
+        slot = &tf->rel_tx[TF_REL_SLOT(tf->rel_tx_base)];
+        if (!slot->acked) return;
+
+        // the slot is free for a new message from the callback
+        tf->rel_tx_base++;
+
+        if (slot->done != NULL) {
+            TF_ClearMsg(&msg);
+            msg.frame_id = slot->frame_id;
+            msg.type = slot->type;
+            msg.data = slot->failed ? NULL : slot->data;
+            msg.len = slot->len;
+            msg.userdata = slot->userdata;
+            msg.userdata2 = slot->userdata2;
+            slot->done(tf, &msg);
+        }
+    }
+}
 
-                if (res == TF_CLOSE) {
-                    cleanup_type_listener(tf, i, tlst);
-                }
-                return;
-            }
+/**
+ * Handle an ack of sent messages
+ *
+ * @param tf - instance
+ * @param next - next sequence nr the peer expects, all before it were received
+ * @param bits - sequence nrs after next that were received
+ */
+static void _TF_FN rel_tx_acked(TinyFrame *tf, uint16_t next, uint32_t bits)
+{
+    uint16_t sent = (uint16_t) (tf->rel_tx_next - tf->rel_tx_base);
+    struct TF_RelTx_ *slot;
+    struct TF_RelTx_ *last = NULL;
+    uint16_t seq;
+    int i;
+
+    // an old ack, or one for messages never sent (the peer restarted)
+    if ((uint16_t) (next - tf->rel_tx_base) > sent) return;
+
+    for (seq = tf->rel_tx_base; seq != next; seq++) {
+        tf->rel_tx[TF_REL_SLOT(seq)].acked = true;
+    }
+    for (i = 0; i < TF_REL_WINDOW - 1; i++) {
+        seq = (uint16_t) (next + 1 + i);
+        if ((bits & ((uint32_t) 1 << i)) && (uint16_t) (seq - tf->rel_tx_base) < sent) {
+            last = &tf->rel_tx[TF_REL_SLOT(seq)];
+            last->acked = true;
         }
     }
 
-    // Generic listeners
-    for (i = 0; i < tf->count_generic_lst; i++) {
-        glst = &tf->generic_listeners[i];
+    // Frames don't overtake each other - messages sent before one that arrived were lost.
+    // Send them again on the next tick, without waiting for the timeout.
+    if (last != NULL) {
+        for (seq = next; &tf->rel_tx[TF_REL_SLOT(seq)] != last; seq++) {
+            slot = &tf->rel_tx[TF_REL_SLOT(seq)];
+            if (!slot->acked && (int32_t) (slot->stamp - last->stamp) < 0) slot->timer = 0;
+        }
+    }
 
-        if (glst->fn) {
-            res = glst->fn(tf, &msg);
+    rel_tx_release(tf);
+}
 
-            if (res != TF_NEXT) {
-                // generic listeners don't have userdata.
-                // TF_RENEW doesn't make sense here because generic listeners don't expire = same as TF_STAY
+/**
+ * Handle a received reliable frame - a message or an ack
+ *
+ * @param tf - instance
+ * @param msg - the frame
+ */
+static void _TF_FN rel_receive(TinyFrame *tf, TF_Msg *msg)
+{
+    const uint8_t *data = msg->data;
+    TF_LEN len = msg->len;
+    struct TF_RelRx_ *slot;
+    uint16_t seq, base;
+    uint32_t bits = 0;
+    TF_TYPE type = 0;
+    int16_t ahead;
+    int i;
+
+    if (len == TF_REL_ACK_LEN && data[0] == TF_REL_ACK) {
+        for (i = 0; i < 4; i++) {
+            bits = (bits << 8) | data[3 + i];
+        }
+        rel_tx_acked(tf, (uint16_t) ((data[1] << 8) | data[2]), bits);
+        return;
+    }
 
-                // note: It's not expected that user will have multiple generic listeners, or
-                // ever actually remove them. They're most useful as default callbacks if no other listener
-                // handled the message.
+    if (len < TF_REL_HEAD_LEN || data[0] != TF_REL_DATA) return;
+    seq = (uint16_t) ((data[1] << 8) | data[2]);
+    base = (uint16_t) ((data[3] << 8) | data[4]);
+    for (i = 0; i < TF_TYPE_BYTES; i++) {
+        type = (TF_TYPE) ((type << 8) | data[5 + i]);
+    }
+    data += TF_REL_HEAD_LEN;
+    len = (TF_LEN) (len - TF_REL_HEAD_LEN);
 
-                if (res == TF_CLOSE) {
-                    cleanup_generic_listener(tf, i, glst);
-                }
-                return;
-            }
+    rel_rx_skip(tf, base);
+
+    ahead = (int16_t) (seq - tf->rel_rx_next);
+    if (ahead < 0 || ahead >= TF_REL_WINDOW) {
+        // a duplicate, our ack was lost - send it again
+        rel_ack(tf);
+        return;
+    }
+
+    if (ahead > 0) {
+        // came early, keep it until the missing ones arrive
+        slot = &tf->rel_rx[TF_REL_SLOT(seq)];
+        if (!slot->used && len <= TF_REL_MAX_LEN) {
+            slot->used = true;
+            slot->seq = seq;
+            slot->frame_id = msg->frame_id;
+            slot->type = type;
+            slot->len = len;
+            memcpy(slot->data, data, len);
         }
+        // a gap - tell the sender now, so it doesn't wait for the timeout
+        rel_ack(tf);
+        return;
+    }
+
+    tf->rel_rx_next++;
+    rel_deliver(tf, msg->frame_id, type, data, len);
+    rel_rx_flush(tf);
+
+    if (++tf->rel_rx_unacked >= TF_REL_ACK_EVERY) {
+        rel_ack(tf);
+    } else {
+        tf->rel_ack_due = true; // sent on the next tick
+    }
+}
+
+//endregion Reliable delivery
+#endif
+
+/** Pass a received frame to the listeners, or to the reassembly if it's a fragment */
+static inline void _TF_FN TF_DispatchReceived(TinyFrame *tf, TF_Msg *msg)
+{
+#if TF_USE_FLOW_CONTROL
+    TF_LEN len = msg->len;
+
+    if (msg->type == TF_FLOW_TYPE) {
+        flow_receive(tf, msg);
+        return;
+    }
+#endif
+
+#if TF_USE_COMPRESSION
+    if (msg->type == TF_COMP_TYPE) {
+        if (comp_unpack(tf, msg)) TF_DispatchMessage(tf, msg);
+    } else
+#endif
+#if TF_USE_RELIABLE
+    if (msg->type == TF_REL_TYPE) {
+        rel_receive(tf, msg);
+    } else
+#endif
+#if TF_USE_FRAGMENTS
+    if (msg->type == TF_FRAG_TYPE) {
+        frag_rx_accept(tf, msg);
+    } else
+#endif
+    {
+        TF_DispatchMessage(tf, msg);
+    }
+
+#if TF_USE_FLOW_CONTROL
+    flow_consumed(tf, len);
+#endif
+}
+
+#if TF_USE_RX_QUEUE
+/** Queue a message collected by the parser, to be handled by TF_DispatchPending() */
+static void _TF_FN rxq_push(TinyFrame *tf)
+{
+    uint16_t head = tf->rxq_head; // only written here
+    uint16_t next = (uint16_t) (head + 1 == TF_RX_QUEUE_LEN ? 0 : head + 1);
+    struct TF_QueuedMsg_ *slot;
+
+    if (next == TF_ATOMIC_LOAD(&tf->rxq_tail)) {
+        tf->rxq_dropped++;
+        TF_Error("Rx queue full, frame dropped");
+        return;
+    }
+
+    slot = &tf->rxq[head];
+    slot->frame_id = tf->id;
+    slot->type = tf->type;
+    slot->len = tf->len;
+#if TF_USE_RX_POOL
+    // The buffer goes with the message, it's returned after dispatch
+    slot->data = tf->data;
+    slot->data_class = tf->data_class;
+    tf->data = NULL;
+    tf->data_class = NULL;
+#else
+    memcpy(slot->data, tf->data, tf->len);
+#endif
+
+    // publish the slot
+    TF_ATOMIC_STORE(&tf->rxq_head, next);
+}
+
+/** Run listeners for queued messages */
+uint32_t _TF_FN TF_DispatchPending(TinyFrame *tf, uint32_t max)
+{
+    uint16_t tail = tf->rxq_tail; // only written here
+    struct TF_QueuedMsg_ *slot;
+    uint32_t n = 0;
+    TF_Msg msg;
+
+    while ((max == 0 || n < max) && tail != TF_ATOMIC_LOAD(&tf->rxq_head)) {
+        slot = &tf->rxq[tail];
+
+        TF_ClearMsg(&msg);
+        msg.frame_id = slot->frame_id;
+        msg.is_response = false;
+        msg.type = slot->type;
+        msg.data = slot->data;
+        msg.len = slot->len;
+        TF_DispatchReceived(tf, &msg);
+
+#if TF_USE_RX_POOL
+        rxpool_give(tf->rx_pool, slot->data_class, slot->data);
+#endif
+
+        // free the slot
+        tail = (uint16_t) (tail + 1 == TF_RX_QUEUE_LEN ? 0 : tail + 1);
+        TF_ATOMIC_STORE(&tf->rxq_tail, tail);
+        n++;
+    }
+
+    return n;
+}
+#endif
+
+/** Handle a message that was just collected & verified by the parser */
+static void _TF_FN TF_HandleReceivedMessage(TinyFrame *tf)
+{
+#if TF_USE_RX_QUEUE
+  #if TF_USE_FLOW_CONTROL
+    // credit is for our sending side, it mustn't wait in the queue. Probes are queued,
+    // they use the receive counters of the TF_DispatchPending() thread.
+    if (tf->type == TF_FLOW_TYPE && tf->len == TF_FLOW_MSG_LEN && tf->data[0] == TF_FLOW_GRANT) {
+        TF_Msg msg;
+        TF_ClearMsg(&msg);
+        msg.frame_id = tf->id;
+        msg.type = tf->type;
+        msg.data = tf->data;
+        msg.len = tf->len;
+        flow_receive(tf, &msg);
+        return;
     }
+  #endif
+    // listeners are run later, by TF_DispatchPending()
+    rxq_push(tf);
+#else
+    // Prepare message object
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.frame_id = tf->id;
+    msg.is_response = false;
+    msg.type = tf->type;
+  #if TF_USE_ZEROCOPY_RX
+    msg.data = tf->data_ext ? tf->data_ext : tf->data;
+  #else
+    msg.data = tf->data;
+  #endif
+    msg.len = tf->len;
 
-    TF_Error("Unhandled message, type %d", (int)msg.type);
+    TF_DispatchReceived(tf, &msg);
+#endif
 }
 
 /** Externally renew an ID listener */
 bool _TF_FN TF_RenewIdListener(TinyFrame *tf, TF_ID id)
 {
+#if TF_USE_ID_HASH
+    int32_t slot = id_hash_find(tf, id, -1);
+    if (slot >= 0) {
+        renew_id_listener(tf, (TF_COUNT) slot, &tf->id_listeners[slot]);
+        return true;
+    }
+#else
     TF_COUNT i;
     struct TF_IdListener_ *lst;
     for (i = 0; i < tf->count_id_lst; i++) {
         lst = &tf->id_listeners[i];
         // test if live & matching
         if (lst->fn != NULL && lst->id == id) {
-            renew_id_listener(lst);
+            renew_id_listener(tf, i, lst);
             return true;
         }
     }
+#endif
 
     TF_Error("Renew listener: not found (id %d)", (int)id);
     return false;
@@ -547,18 +2553,65 @@ bool _TF_FN TF_RenewIdListener(TinyFrame *tf, TF_ID id)
 
 //region Parser
 
-/** Handle a received byte buffer */
-void _TF_FN TF_Accept(TinyFrame *tf, const uint8_t *buffer, uint32_t count)
+// Size of the RX buffer
+#if TF_USE_RX_POOL
+#define RX_BUF_LEN(tf) ((tf)->data_class->size)
+#else
+#define RX_BUF_LEN(tf) TF_MAX_PAYLOAD_RX
+#endif
+
+#if TF_USE_STREAM_RX
+/** Pass a payload chunk or the final result of a streamed frame to its listener */
+static void _TF_FN pars_stream_notify(TinyFrame *tf, TF_StreamEvent event, const uint8_t *data, TF_LEN len)
 {
-    uint32_t i;
-    for (i = 0; i < count; i++) {
-        TF_AcceptChar(tf, buffer[i]);
+    TF_StreamListener fn = tf->stream_fn;
+#if TF_USE_FLOW_CONTROL
+    TF_LEN frame_len = tf->len;
+#endif
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.frame_id = tf->id;
+    msg.type = tf->type;
+    msg.data = data;
+    msg.len = len;
+
+    if (event != TF_STREAM_DATA) {
+        // the frame is over, a reset from inside the callback must not report it again
+        tf->stream_fn = NULL;
+    }
+    fn(tf, &msg, event, tf->stream_pos);
+
+#if TF_USE_FLOW_CONTROL
+    if (event != TF_STREAM_DATA) {
+        flow_consumed(tf, frame_len);
     }
+#endif
+}
+
+/** Pass the buffered part of a streamed payload to the listener */
+static void _TF_FN pars_stream_flush(TinyFrame *tf)
+{
+    TF_LEN n = tf->rxi - tf->stream_pos;
+    if (n == 0) return;
+    pars_stream_notify(tf, TF_STREAM_DATA, tf->data, n);
+    tf->stream_pos = tf->rxi;
 }
+#endif
 
 /** Reset the parser's internal state. */
 void _TF_FN TF_ResetParser(TinyFrame *tf)
 {
+#if TF_USE_STREAM_RX
+    if (tf->stream_fn != NULL) {
+        // a streamed frame was cut off
+        pars_stream_notify(tf, TF_STREAM_ERROR, NULL, tf->len);
+        tf->stream_fn = NULL;
+    }
+#endif
+#if TF_USE_RX_POOL
+    // the frame was handled by the listeners, or dropped
+    rxpool_release(tf);
+#endif
     tf->state = TFState_SOF;
     // more init will be done by the parser when the first byte is received
 }
@@ -570,16 +2623,140 @@ static void _TF_FN pars_begin_frame(TinyFrame *tf) {
 #if TF_USE_SOF_BYTE
     CKSUM_ADD(tf->cksum, TF_SOF_BYTE);
 #endif
+#if TF_USE_RESYNC
+    tf->head_buf[0] = TF_SOF_BYTE;
+    tf->head_len = 1;
+#endif
 
     tf->discard_data = false;
+#if TF_USE_ZEROCOPY_RX
+    tf->data_ext = NULL;
+#endif
 
     // Enter ID state
     tf->state = TFState_ID;
     tf->rxi = 0;
 }
 
+// With zero-copy, the pool buffer is taken only when the first payload byte is stored -
+// a frame used in place needs none
+#define TF_RX_POOL_LAZY (TF_USE_RX_POOL && TF_USE_ZEROCOPY_RX && !TF_USE_RX_QUEUE)
+
+#if TF_RX_POOL_LAZY
+/** Take the pool buffer for the payload, if not taken yet */
+static inline void _TF_FN pars_take_buffer(TinyFrame *tf)
+{
+    if (tf->data_class == NULL && !tf->discard_data && !rxpool_take(tf, tf->len)) {
+        // Out of buffers. Consume, but do not store.
+        tf->discard_data = true;
+    }
+}
+#endif
+
+/** Header was received (and verified) - prepare for the payload */
+static void _TF_FN pars_begin_data(TinyFrame *tf)
+{
+#if TF_USE_STREAM_RX
+    tf->stream_fn = TF_FindStreamListener(tf, tf->type);
+    tf->stream_pos = 0;
+    if (tf->stream_fn != NULL) {
+        if (tf->len == 0) {
+            pars_stream_notify(tf, TF_STREAM_END, NULL, 0);
+            TF_ResetParser(tf);
+            return;
+        }
+
+        // Any length is accepted, the payload is passed on in buffer-sized chunks
+        tf->state = TFState_DATA;
+        tf->rxi = 0;
+        CKSUM_RESET(tf->cksum);
+#if TF_USE_RX_POOL
+        if (!rxpool_take(tf, TF_MIN(tf->len, TF_MAX_PAYLOAD_RX))) {
+            // can't stage, give up on the frame
+            pars_stream_notify(tf, TF_STREAM_ERROR, NULL, 0);
+            tf->discard_data = true;
+        }
+#endif
+        return;
+    }
+#endif
+
+    if (tf->len == 0) {
+        // if the message has no body, we're done.
+        TF_HandleReceivedMessage(tf);
+        TF_ResetParser(tf);
+        return;
+    }
+
+    // Enter DATA state
+    tf->state = TFState_DATA;
+    tf->rxi = 0;
+
+    CKSUM_RESET(tf->cksum); // Start collecting the payload
+
+    if (tf->len > TF_MAX_PAYLOAD_RX) {
+        TF_Error("Rx payload too long: %d", (int)tf->len);
+        // ERROR - frame too long. Consume, but do not store.
+        tf->discard_data = true;
+    }
+#if TF_USE_RX_POOL && !TF_RX_POOL_LAZY
+    else if (!rxpool_take(tf, tf->len)) {
+        // Out of buffers. Consume, but do not store.
+        tf->discard_data = true;
+    }
+#endif
+}
+
+#if TF_USE_RESYNC
+/** Header checksum failed - parse again from the next SOF found in the header bytes */
+static void _TF_FN pars_resync(TinyFrame *tf)
+{
+    uint8_t window[sizeof(tf->head_buf)];
+    uint8_t n = tf->head_len;
+    uint8_t i;
+
+    memcpy(window, tf->head_buf, n);
+    TF_ResetParser(tf);
+
+    // window[0] is the SOF of the rejected frame.
+    // What follows is shorter than a header, so the replay can't fail again.
+    for (i = 1; i < n && window[i] != TF_SOF_BYTE; i++);
+    for (; i < n; i++) {
+        TF_AcceptChar(tf, window[i]);
+    }
+}
+#endif
+
+/** The whole payload was received */
+static void _TF_FN pars_end_data(TinyFrame *tf)
+{
+#if TF_USE_STREAM_RX
+    if (tf->stream_fn != NULL) {
+        pars_stream_flush(tf);
+    }
+#endif
+
+#if TF_CKSUM_TYPE == TF_CKSUM_NONE
+    // All done
+  #if TF_USE_STREAM_RX
+    if (tf->stream_fn != NULL) {
+        pars_stream_notify(tf, TF_STREAM_END, NULL, tf->len);
+    } else
+  #endif
+    if (!tf->discard_data) {
+        TF_HandleReceivedMessage(tf);
+    }
+    TF_ResetParser(tf);
+#else
+    // Enter DATA_CKSUM state
+    tf->state = TFState_DATA_CKSUM;
+    tf->rxi = 0;
+    tf->ref_cksum = 0;
+#endif
+}
+
 /** Handle a received char - here's the main state machine */
-void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
+static void _TF_FN pars_char(TinyFrame *tf, unsigned char c)
 {
     // Parser timeout - clear
     if (tf->parser_timeout_ticks >= TF_PARSER_TIMEOUT_TICKS) {
@@ -597,12 +2774,40 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
 #define COLLECT_NUMBER(dest, type) dest = (type)(((dest) << 8) | c); \
                                    if (++tf->rxi == sizeof(type))
 
-#if !TF_USE_SOF_BYTE
+#if TF_USE_VARINT
+// Same for a varint, 'dest' must start at 0. A value that doesn't fit the type, or one
+// that goes on past the largest length, means a corrupted head.
+#define COLLECT_VARINT(dest, type) if (((dest) >> (sizeof(type) * 8 - 7)) != 0 || \
+                                       ((c & 0x80) && tf->rxi == (sizeof(type) * 8 + 6) / 7 - 1)) { \
+                                       TF_Error("Rx head varint too long"); \
+                                       TF_ResetParser(tf); \
+                                       break; \
+                                   } \
+                                   dest = (type)(((dest) << 7) | (c & 0x7F)); \
+                                   tf->rxi++; \
+                                   if (!(c & 0x80))
+#endif
+
+#if TF_USE_COBS
+    if (tf->state == TFState_SOF) {
+        // a frame starts right after a delimiter, other bytes are left over from a bad frame
+        if (!tf->cobs_sync) return;
+        tf->cobs_sync = false;
+        pars_begin_frame(tf);
+    }
+#elif !TF_USE_SOF_BYTE
     if (tf->state == TFState_SOF) {
         pars_begin_frame(tf);
     }
 #endif
 
+#if TF_USE_RESYNC
+    // Keep the header bytes, they are searched for a SOF if the header turns out to be corrupted
+    if (tf->state != TFState_SOF && tf->state < TFState_DATA) {
+        tf->head_buf[tf->head_len++] = c;
+    }
+#endif
+
     //@formatter:off
     switch (tf->state) {
         case TFState_SOF:
@@ -617,24 +2822,33 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
                 // Enter LEN state
                 tf->state = TFState_LEN;
                 tf->rxi = 0;
+                tf->len = 0;
             }
             break;
 
         case TFState_LEN:
             CKSUM_ADD(tf->cksum, c);
+#if TF_USE_VARINT
+            COLLECT_VARINT(tf->len, TF_LEN) {
+#else
             COLLECT_NUMBER(tf->len, TF_LEN) {
+#endif
                 // Enter TYPE state
                 tf->state = TFState_TYPE;
                 tf->rxi = 0;
+                tf->type = 0;
             }
             break;
 
         case TFState_TYPE:
             CKSUM_ADD(tf->cksum, c);
+#if TF_USE_VARINT
+            COLLECT_VARINT(tf->type, TF_TYPE) {
+#else
             COLLECT_NUMBER(tf->type, TF_TYPE) {
+#endif
                 #if TF_CKSUM_TYPE == TF_CKSUM_NONE
-                    tf->state = TFState_DATA;
-                    tf->rxi = 0;
+                    pars_begin_data(tf);
                 #else
                     // enter HEAD_CKSUM state
                     tf->state = TFState_HEAD_CKSUM;
@@ -651,50 +2865,41 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
 
                 if (tf->cksum != tf->ref_cksum) {
                     TF_Error("Rx head cksum mismatch");
+#if TF_USE_RESYNC
+                    pars_resync(tf);
+#else
                     TF_ResetParser(tf);
+#endif
                     break;
                 }
 
-                if (tf->len == 0) {
-                    // if the message has no body, we're done.
-                    TF_HandleReceivedMessage(tf);
-                    TF_ResetParser(tf);
-                    break;
-                }
-
-                // Enter DATA state
-                tf->state = TFState_DATA;
-                tf->rxi = 0;
-
-                CKSUM_RESET(tf->cksum); // Start collecting the payload
-
-                if (tf->len > TF_MAX_PAYLOAD_RX) {
-                    TF_Error("Rx payload too long: %d", (int)tf->len);
-                    // ERROR - frame too long. Consume, but do not store.
-                    tf->discard_data = true;
-                }
+                pars_begin_data(tf);
             }
             break;
 
         case TFState_DATA:
+#if TF_RX_POOL_LAZY
+            if (tf->rxi == 0) pars_take_buffer(tf);
+#endif
             if (tf->discard_data) {
                 tf->rxi++;
-            } else {
+            }
+#if TF_USE_STREAM_RX
+            else if (tf->stream_fn != NULL) {
+                CKSUM_ADD(tf->cksum, c);
+                tf->data[tf->rxi++ - tf->stream_pos] = c;
+                if (tf->rxi - tf->stream_pos == RX_BUF_LEN(tf)) {
+                    pars_stream_flush(tf);
+                }
+            }
+#endif
+            else {
                 CKSUM_ADD(tf->cksum, c);
                 tf->data[tf->rxi++] = c;
             }
 
             if (tf->rxi == tf->len) {
-                #if TF_CKSUM_TYPE == TF_CKSUM_NONE
-                    // All done
-                    TF_HandleReceivedMessage(tf);
-                    TF_ResetParser(tf);
-                #else
-                    // Enter DATA_CKSUM state
-                    tf->state = TFState_DATA_CKSUM;
-                    tf->rxi = 0;
-                    tf->ref_cksum = 0;
-                #endif
+                pars_end_data(tf);
             }
             break;
 
@@ -702,6 +2907,16 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
             COLLECT_NUMBER(tf->ref_cksum, TF_CKSUM) {
                 // Check the header checksum against the computed value
                 CKSUM_FINALIZE(tf->cksum);
+#if TF_USE_STREAM_RX
+                if (tf->stream_fn != NULL) {
+                    if (tf->cksum == tf->ref_cksum) {
+                        pars_stream_notify(tf, TF_STREAM_END, NULL, tf->len);
+                    } else {
+                        TF_Error("Body cksum mismatch");
+                        pars_stream_notify(tf, TF_STREAM_ERROR, NULL, tf->len);
+                    }
+                } else
+#endif
                 if (!tf->discard_data) {
                     if (tf->cksum == tf->ref_cksum) {
                         TF_HandleReceivedMessage(tf);
@@ -717,9 +2932,393 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
     //@formatter:on
 }
 
+/** Handle a buffer of frame bytes */
+static void _TF_FN pars_accept(TinyFrame *tf, const uint8_t *buffer, uint32_t count)
+{
+    uint32_t i = 0;
+    uint32_t chunk;
+
+    while (i < count) {
+        // Header fields and the first payload byte go through the state machine
+        pars_char(tf, buffer[i++]);
+
+        if (tf->state != TFState_DATA || i >= count) continue;
+
+#if TF_USE_STREAM_RX
+        if (tf->stream_fn != NULL) {
+            chunk = TF_MIN((uint32_t) (tf->len - tf->rxi), count - i);
+
+            if (tf->rxi == tf->stream_pos) {
+                // nothing buffered - pass the chunk on in place
+                CKSUM_ADD_BLOCK(tf->cksum, buffer + i, chunk);
+                tf->rxi += (TF_LEN) chunk;
+                pars_stream_notify(tf, TF_STREAM_DATA, buffer + i, (TF_LEN) chunk);
+                tf->stream_pos = tf->rxi;
+            } else {
+                chunk = TF_MIN(chunk, (uint32_t) (RX_BUF_LEN(tf) - (tf->rxi - tf->stream_pos)));
+                memcpy(tf->data + (tf->rxi - tf->stream_pos), buffer + i, chunk);
+                CKSUM_ADD_BLOCK(tf->cksum, buffer + i, chunk);
+                tf->rxi += (TF_LEN) chunk;
+                if (tf->rxi - tf->stream_pos == RX_BUF_LEN(tf)) {
+                    pars_stream_flush(tf);
+                }
+            }
+
+            i += chunk;
+            if (tf->rxi == tf->len) {
+                pars_end_data(tf);
+            }
+            continue;
+        }
+#endif
+
+#if TF_USE_ZEROCOPY_RX && !TF_USE_RX_QUEUE
+        // The rest of the frame is in this buffer - use the payload in place
+        if (tf->rxi == 0 && !tf->discard_data
+            && count - i >= (uint32_t) tf->len + (TF_CKSUM_TYPE == TF_CKSUM_NONE ? 0 : sizeof(TF_CKSUM))) {
+            tf->data_ext = buffer + i;
+            CKSUM_ADD_BLOCK(tf->cksum, buffer + i, tf->len);
+            tf->rxi = tf->len;
+            i += tf->len;
+            pars_end_data(tf);
+            continue;
+        }
+#endif
+
+        // Bulk-copy the payload body. The last payload byte is left for pars_char(),
+        // so the end-of-data transition stays in one place.
+        chunk = TF_MIN((uint32_t) (tf->len - tf->rxi - 1), count - i);
+        if (chunk == 0) continue;
+
+#if TF_RX_POOL_LAZY
+        pars_take_buffer(tf);
+#endif
+        if (!tf->discard_data) {
+            memcpy(tf->data + tf->rxi, buffer + i, chunk);
+            CKSUM_ADD_BLOCK(tf->cksum, buffer + i, chunk);
+        }
+
+        tf->rxi += (TF_LEN) chunk;
+        i += chunk;
+    }
+}
+
+#if TF_USE_COBS
+/** A delimiter was received - the next frame starts after it */
+static void _TF_FN cobs_delimiter(TinyFrame *tf)
+{
+    if (tf->state != TFState_SOF) {
+        TF_Error("Frame cut off");
+        TF_ResetParser(tf);
+    }
+    tf->cobs_sync = true;
+    tf->cobs_left = 0;
+    tf->cobs_zero = false; // the last group's zero is not part of the frame
+}
+
+/** Handle a received byte buffer - decode it, and parse the runs of frame bytes in place */
+void _TF_FN TF_Accept(TinyFrame *tf, const uint8_t *buffer, uint32_t count)
+{
+    static const uint8_t zero = 0;
+    const uint8_t *end = buffer + count;
+    const uint8_t *delim;
+    uint32_t n;
+    uint8_t c;
+
+    while (buffer < end) {
+        if (tf->cobs_left == 0) {
+            // a group code
+            c = *buffer++;
+            if (c == 0) {
+                cobs_delimiter(tf);
+                continue;
+            }
+            // the previous group ended with a zero, if a group follows
+            if (tf->cobs_zero) pars_accept(tf, &zero, 1);
+            tf->cobs_left = (uint8_t) (c - 1);
+            tf->cobs_zero = (c != 0xFF);
+            continue;
+        }
+
+        // group bytes - a delimiter among them means the frame was cut off
+        n = TF_MIN(tf->cobs_left, (uint32_t) (end - buffer));
+        delim = memchr(buffer, 0, n);
+        if (delim != NULL) n = (uint32_t) (delim - buffer);
+
+        pars_accept(tf, buffer, n);
+        buffer += n;
+        tf->cobs_left = (uint8_t) (tf->cobs_left - n);
+
+        if (delim != NULL) {
+            buffer++;
+            cobs_delimiter(tf);
+        }
+    }
+}
+
+/** Handle a received char */
+void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
+{
+    TF_Accept(tf, &c, 1);
+}
+#else
+/** Handle a received byte buffer */
+void _TF_FN TF_Accept(TinyFrame *tf, const uint8_t *buffer, uint32_t count)
+{
+    pars_accept(tf, buffer, count);
+}
+
+/** Handle a received char */
+void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
+{
+    pars_char(tf, c);
+}
+#endif
+
 //endregion Parser
 
 
+#if TF_USE_TX_QUEUE
+//region TX queue
+
+#define TF_TXQ_MASK ((TF_TX_QUEUE_LEN) - 1)
+#define TF_TXQ_NEXT(i) ((uint16_t) ((i) + 1 == TF_TX_QUEUE_FRAMES ? 0 : (i) + 1))
+
+/**
+ * Get the priority class of a message to send
+ *
+ * @param msg - message
+ * @return class index
+ */
+static inline uint8_t _TF_FN txq_priority(const TF_Msg *msg)
+{
+    uint8_t prio = msg->priority;
+#ifdef TF_TX_TYPE_PRIORITY
+    uint8_t type_prio = (uint8_t) (TF_TX_TYPE_PRIORITY(msg->type));
+    if (type_prio > prio) prio = type_prio;
+#endif
+    if (prio >= TF_TX_PRIORITIES) prio = TF_TX_PRIORITIES - 1;
+    return prio;
+}
+
+/**
+ * Reserve space for a frame in a TX queue, and a frame slot
+ *
+ * @param tf - instance
+ * @param prio - priority class
+ * @param head_len - frame head length
+ * @param payload_len - payload length
+ * @return success
+ */
+static bool _TF_FN txq_reserve(TinyFrame *tf, uint8_t prio, uint32_t head_len, uint32_t payload_len)
+{
+    struct TF_TxClass_ *q = &tf->txq[prio];
+    uint32_t size = head_len + payload_len + (payload_len > 0 ? TF_CKSUM_LEN : 0);
+
+    if (size > TF_TX_QUEUE_LEN - (q->head - TF_ATOMIC_LOAD(&q->tail))) {
+        TF_Error("TX queue full");
+        return false;
+    }
+
+    if (TF_TXQ_NEXT(q->frame_head) == TF_ATOMIC_LOAD(&q->frame_tail)) {
+        TF_Error("TX queue full (frames)");
+        return false;
+    }
+
+    tf->txq_prio = prio;
+    tf->txq_write = q->head;
+    return true;
+}
+
+/**
+ * Copy bytes to the TX queue, at the write position
+ *
+ * @param tf - instance
+ * @param data - bytes
+ * @param len - count, must fit in the reserved space
+ */
+static void _TF_FN txq_put(TinyFrame *tf, const uint8_t *data, uint32_t len)
+{
+    uint8_t *buf = tf->txq[tf->txq_prio].buf;
+    uint32_t index = tf->txq_write & TF_TXQ_MASK;
+    uint32_t first = TF_MIN(len, TF_TX_QUEUE_LEN - index);
+
+    memcpy(buf + index, data, first);
+    memcpy(buf, data + first, len - first);
+    tf->txq_write += len;
+}
+
+/**
+ * Make the composed frame available to TF_TxDrain()
+ *
+ * @param tf - instance
+ */
+static void _TF_FN txq_publish(TinyFrame *tf)
+{
+    struct TF_TxClass_ *q = &tf->txq[tf->txq_prio];
+    uint16_t head = q->frame_head; // only written here
+    struct TF_TxFrame_ *slot = &q->frames[head];
+
+    slot->end = tf->txq_write;
+    slot->frame_id = tf->tx_done_id;
+    slot->cb = tf->tx_done;
+    slot->userdata = tf->tx_done_data;
+#if TF_TX_STATS
+    slot->size = tf->txq_write - q->head;
+    slot->queued = TF_TxTimestamp(tf);
+#endif
+
+    TF_ATOMIC_STORE(&q->head, tf->txq_write);
+    TF_ATOMIC_STORE(&q->frame_head, TF_TXQ_NEXT(head));
+}
+
+/**
+ * Pick the bytes TF_TxDrain() returns next - the whole queue if there's one class,
+ * otherwise a frame from the class chosen by the scheduler.
+ *
+ * @param tf - instance
+ * @return false if nothing is queued
+ */
+static bool _TF_FN txq_schedule(TinyFrame *tf)
+{
+    struct TF_TxClass_ *q;
+    int c;
+#if TF_TX_PRIORITIES == 1
+    (void) c;
+    q = &tf->txq[0];
+    tf->txq_cur_end = TF_ATOMIC_LOAD(&q->head);
+    return tf->txq_cur_end != q->tail;
+#elif TF_TX_SCHED == TF_TX_SCHED_WEIGHTED
+    int round;
+
+    for (round = 0; round < 2; round++) {
+        for (c = TF_TX_PRIORITIES - 1; c >= 0; c--) {
+            q = &tf->txq[c];
+            if (q->credit > 0 && q->frame_tail != TF_ATOMIC_LOAD(&q->frame_head)) {
+                q->credit--;
+                tf->txq_cur = (uint8_t) c;
+                tf->txq_cur_end = q->frames[q->frame_tail].end;
+                return true;
+            }
+        }
+
+        // All classes with frames have used their share, start a new round
+        for (c = 0; c < TF_TX_PRIORITIES; c++) {
+            tf->txq[c].credit = tf->txq[c].weight;
+        }
+    }
+    return false;
+#else
+    for (c = TF_TX_PRIORITIES - 1; c >= 0; c--) {
+        q = &tf->txq[c];
+        if (q->frame_tail != TF_ATOMIC_LOAD(&q->frame_head)) {
+            tf->txq_cur = (uint8_t) c;
+            tf->txq_cur_end = q->frames[q->frame_tail].end;
+            return true;
+        }
+    }
+    return false;
+#endif
+}
+
+/** Get queued bytes to send */
+uint32_t _TF_FN TF_TxDrain(TinyFrame *tf, const uint8_t **data, uint32_t space)
+{
+    struct TF_TxClass_ *q = &tf->txq[tf->txq_cur];
+    uint32_t index;
+    uint32_t count;
+
+    // Choose what to send when the previous choice was sent completely
+    if (q->tail == tf->txq_cur_end) {
+        if (!txq_schedule(tf)) return 0;
+        q = &tf->txq[tf->txq_cur];
+    }
+
+    index = q->tail & TF_TXQ_MASK;
+    count = tf->txq_cur_end - q->tail;
+    count = TF_MIN(count, TF_TX_QUEUE_LEN - index); // up to the end of the buffer
+    count = TF_MIN(count, space);
+
+    *data = q->buf + index;
+    return count;
+}
+
+/** Confirm bytes from TF_TxDrain() were sent */
+void _TF_FN TF_TxComplete(TinyFrame *tf, uint32_t n)
+{
+    struct TF_TxClass_ *q = &tf->txq[tf->txq_cur];
+    uint32_t tail = q->tail; // only written here
+    uint16_t done = q->frame_tail;
+    struct TF_TxFrame_ slot;
+#if TF_TX_STATS
+    uint32_t delay;
+#endif
+
+    if (n > tf->txq_cur_end - tail) {
+        TF_Error("TF_TxComplete() for more bytes than drained");
+        n = tf->txq_cur_end - tail;
+    }
+    tail += n;
+    TF_ATOMIC_STORE(&q->tail, tail);
+
+    // Frames sent so far
+    while (done != TF_ATOMIC_LOAD(&q->frame_head)) {
+        if ((int32_t) (q->frames[done].end - tail) > 0) break;
+
+        // free the slot first - the callback may send another frame
+        slot = q->frames[done];
+        done = TF_TXQ_NEXT(done);
+        TF_ATOMIC_STORE(&q->frame_tail, done);
+
+#if TF_TX_STATS
+        delay = TF_TxTimestamp(tf) - slot.queued;
+        q->stats.frames++;
+        q->stats.bytes += slot.size;
+        q->stats.delay_sum += delay;
+        if (delay > q->stats.delay_max) q->stats.delay_max = delay;
+#endif
+
+        if (slot.cb != NULL) {
+            slot.cb(tf, slot.frame_id, slot.userdata);
+        }
+    }
+}
+
+#if TF_TX_SCHED == TF_TX_SCHED_WEIGHTED
+/** Set the share of a priority class */
+void _TF_FN TF_TxSetWeight(TinyFrame *tf, uint8_t priority, uint16_t weight)
+{
+    if (priority >= TF_TX_PRIORITIES) {
+        TF_Error("TF_TxSetWeight() - no priority class %d", (int) priority);
+        return;
+    }
+    tf->txq[priority].weight = (uint16_t) (weight > 0 ? weight : 1);
+}
+#endif
+
+#if TF_TX_STATS
+/** Get the TX statistics of a priority class */
+bool _TF_FN TF_TxGetStats(TinyFrame *tf, uint8_t priority, TF_TxStats *stats)
+{
+    if (priority >= TF_TX_PRIORITIES) return false;
+    *stats = tf->txq[priority].stats;
+    return true;
+}
+
+/** Clear the TX statistics */
+void _TF_FN TF_TxResetStats(TinyFrame *tf)
+{
+    int c;
+    for (c = 0; c < TF_TX_PRIORITIES; c++) {
+        memset(&tf->txq[c].stats, 0, sizeof(TF_TxStats));
+    }
+}
+#endif
+
+//endregion TX queue
+#endif
+
+
 //region Compose and send
 
 // Helper macros for the Compose functions
@@ -761,6 +3360,23 @@ void _TF_FN TF_AcceptChar(TinyFrame *tf, unsigned char c)
  */
 #define WRITENUM_CKSUM(type, num) WRITENUM_BASE(type, num, CKSUM_ADD(cksum, b))
 
+#if TF_USE_VARINT
+/**
+ * Write a number as a varint AND add its bytes to the checksum.
+ * 7 bits per byte, most significant first, leading zero groups left out.
+ *
+ * @param type - data type
+ * @param num - number to write
+ */
+#define WRITEVARINT_CKSUM(type, num) \
+    for (si = (sizeof(type)*8+6)/7-1; si>0 && ((num) >> (si*7)) == 0; si--); \
+    for (; si>=0; si--) { \
+        b = (uint8_t)(((num) >> (si*7) & 0x7F) | (si ? 0x80 : 0)); \
+        outbuff[pos++] = b; \
+        CKSUM_ADD(cksum, b); \
+    }
+#endif
+
 /**
  * Compose a frame (used internally by TF_Send and TF_Respond).
  * The frame can be sent using TF_WriteImpl(), or received by TF_Accept()
@@ -786,7 +3402,12 @@ static inline uint32_t _TF_FN TF_ComposeHead(TinyFrame *tf, uint8_t *outbuff, TF
         id = msg->frame_id;
     }
     else {
+#if TF_USE_MPSC_TX
+        // TF_EncodeFrame() runs in many threads at once
+        id = (TF_ID) (__atomic_fetch_add(&tf->next_id, 1, __ATOMIC_RELAXED) & TF_ID_MASK);
+#else
         id = (TF_ID) (tf->next_id++ & TF_ID_MASK);
+#endif
         if (tf->peer_bit) {
             id |= TF_ID_PEERBIT;
         }
@@ -803,8 +3424,13 @@ static inline uint32_t _TF_FN TF_ComposeHead(TinyFrame *tf, uint8_t *outbuff, TF
 #endif
 
     WRITENUM_CKSUM(TF_ID, id);
+#if TF_USE_VARINT
+    WRITEVARINT_CKSUM(TF_LEN, msg->len);
+    WRITEVARINT_CKSUM(TF_TYPE, msg->type);
+#else
     WRITENUM_CKSUM(TF_LEN, msg->len);
     WRITENUM_CKSUM(TF_TYPE, msg->type);
+#endif
 
 #if TF_CKSUM_TYPE != TF_CKSUM_NONE
     CKSUM_FINALIZE(cksum);
@@ -828,17 +3454,9 @@ static inline uint32_t _TF_FN TF_ComposeBody(uint8_t *outbuff,
                                     const uint8_t *data, TF_LEN data_len,
                                     TF_CKSUM *cksum)
 {
-    TF_LEN i = 0;
-    uint8_t b = 0;
-    uint32_t pos = 0;
-
-    for (i = 0; i < data_len; i++) {
-        b = data[i];
-        outbuff[pos++] = b;
-        CKSUM_ADD(*cksum, b);
-    }
-
-    return pos;
+    memcpy(outbuff, data, data_len);
+    CKSUM_ADD_BLOCK(*cksum, outbuff, data_len);
+    return data_len;
 }
 
 /**
@@ -861,34 +3479,146 @@ static inline uint32_t _TF_FN TF_ComposeTail(uint8_t *outbuff, TF_CKSUM *cksum)
     return pos;
 }
 
+#if TF_USE_COBS
 /**
- * Begin building and sending a frame
+ * Encode bytes of the frame being sent. Complete groups are sent out when the buffer fills up.
+ *
+ * @param tf - instance
+ * @param buff - bytes to write
+ * @param length - count
+ */
+static void _TF_FN cobs_write(TinyFrame *tf, const uint8_t *buff, uint32_t length)
+{
+    const uint8_t *end = buff + length;
+    const uint8_t *zero;
+    uint32_t n;
+
+    while (buff < end) {
+        // copy up to the next zero, the end of the group or of the buffer (leaving room for a code)
+        n = TF_MIN((uint32_t) (end - buff), 0xFFu - (tf->cobs_pos - tf->cobs_code));
+        n = TF_MIN(n, TF_COBS_BUF_LEN - 1 - tf->cobs_pos);
+        zero = memchr(buff, 0, n);
+        if (zero != NULL) n = (uint32_t) (zero - buff);
+
+        memcpy(tf->cobs_buf + tf->cobs_pos, buff, n);
+        tf->cobs_pos += n;
+        buff += n;
+
+        if (zero != NULL || tf->cobs_pos - tf->cobs_code == 0xFF) {
+            // close the group - it stands for its bytes and a zero, unless it's full
+            tf->cobs_buf[tf->cobs_code] = (uint8_t) (tf->cobs_pos - tf->cobs_code);
+            tf->cobs_code = tf->cobs_pos++;
+            if (zero != NULL) buff++;
+        }
+
+        if (tf->cobs_pos >= TF_COBS_BUF_LEN - 1) {
+            // send the closed groups, keep the open one
+            TF_WriteImpl(tf, tf->cobs_buf, tf->cobs_code);
+            n = tf->cobs_pos - tf->cobs_code;
+            memmove(tf->cobs_buf, tf->cobs_buf + tf->cobs_code, n);
+            tf->cobs_code = 0;
+            tf->cobs_pos = n;
+        }
+    }
+}
+
+/**
+ * Close the last group, add the delimiter and send the rest of the frame
+ *
+ * @param tf - instance
+ */
+static void _TF_FN cobs_end(TinyFrame *tf)
+{
+    tf->cobs_buf[tf->cobs_code] = (uint8_t) (tf->cobs_pos - tf->cobs_code);
+    tf->cobs_buf[tf->cobs_pos++] = 0;
+    TF_WriteImpl(tf, tf->cobs_buf, tf->cobs_pos);
+    tf->cobs_code = 0;
+    tf->cobs_pos = 1;
+}
+
+// Frame bytes go through the encoder
+#define TF_WRITE(tf, buff, len) cobs_write((tf), (buff), (len))
+#else
+#define TF_WRITE(tf, buff, len) TF_WriteImpl((tf), (buff), (len))
+#endif
+
+/**
+ * Begin a frame with the Tx lock already claimed. It's released if this fails.
  *
  * @param tf - instance
  * @param msg - message to send
  * @param listener - response listener or NULL
  * @param ftimeout - time out callback
  * @param timeout - listener timeout ticks, 0 = indefinite
- * @return success (mutex claimed and listener added, if any)
+ * @return success (listener added, if any)
  */
-static bool _TF_FN TF_SendFrame_Begin(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+static bool _TF_FN TF_SendFrame_Start(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
 {
-    TF_TRY(TF_ClaimTx(tf));
+#if TF_USE_FLOW_CONTROL
+    if (msg->type != TF_FLOW_TYPE && !flow_check(tf, msg->len, listener != NULL)) {
+        TF_ReleaseTx(tf);
+        return false;
+    }
+#endif
+
+#if TF_USE_TX_QUEUE
+    // before composing the head, so a frame ID isn't used up if it doesn't fit
+    if (!txq_reserve(tf, txq_priority(msg), TF_HEAD_LEN, msg->len)) {
+        TF_ReleaseTx(tf);
+        return false;
+    }
+    tf->tx_done = msg->tx_done;
+    tf->tx_done_data = msg->userdata;
+#endif
 
     tf->tx_pos = (uint32_t) TF_ComposeHead(tf, tf->sendbuf, msg); // frame ID is incremented here if it's not a response
     tf->tx_len = msg->len;
 
+#if TF_USE_TX_QUEUE
+    tf->tx_done_id = msg->frame_id;
+#endif
+
     if (listener) {
-        if(!TF_AddIdListener(tf, msg, listener, ftimeout, timeout)) {
+        if(!id_listener_add(tf, msg, listener, ftimeout, timeout, true)) {
             TF_ReleaseTx(tf);
             return false;
         }
     }
 
+#if TF_USE_FLOW_CONTROL
+    if (msg->type != TF_FLOW_TYPE) {
+        // read by the receiving thread when a grant comes
+        TF_ATOMIC_STORE(&tf->flow_tx_frames, tf->flow_tx_frames + 1);
+        TF_ATOMIC_STORE(&tf->flow_tx_bytes, tf->flow_tx_bytes + msg->len);
+    }
+#endif
+
+#if TF_USE_TX_QUEUE
+    txq_put(tf, tf->sendbuf, tf->tx_pos);
+    tf->tx_pos = 0;
+    tf->txq_limit = tf->txq_write + msg->len; // after the head, which may be shorter than reserved
+#endif
+
     CKSUM_RESET(tf->tx_cksum);
     return true;
 }
 
+/**
+ * Begin building and sending a frame
+ *
+ * @param tf - instance
+ * @param msg - message to send
+ * @param listener - response listener or NULL
+ * @param ftimeout - time out callback
+ * @param timeout - listener timeout ticks, 0 = indefinite
+ * @return success (mutex claimed and listener added, if any)
+ */
+static bool _TF_FN TF_SendFrame_Begin(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    TF_TRY(TF_ClaimTx(tf));
+    return TF_SendFrame_Start(tf, msg, listener, ftimeout, timeout);
+}
+
 /**
  * Build and send a part (or all) of a frame body.
  * Caution: this does not check the total length against the length specified in the frame head
@@ -899,6 +3629,34 @@ static bool _TF_FN TF_SendFrame_Begin(TinyFrame *tf, TF_Msg *msg, TF_Listener li
  */
 static void _TF_FN TF_SendFrame_Chunk(TinyFrame *tf, const uint8_t *buff, uint32_t length)
 {
+#if TF_USE_TX_QUEUE
+    if (length == 0) return;
+
+    // The frame is queued whole, so it mustn't grow past the space reserved for it
+    if (length > tf->txq_limit - tf->txq_write) {
+        TF_Error("Payload longer than the frame length, truncated");
+        length = tf->txq_limit - tf->txq_write;
+    }
+    CKSUM_ADD_BLOCK(tf->tx_cksum, buff, length);
+    txq_put(tf, buff, length);
+#elif TF_USE_WRITEV
+    TF_IoVec iov[2];
+
+    if (length == 0) return;
+
+    // Send the chunk in place, after the head if it's still in the buffer
+    CKSUM_ADD_BLOCK(tf->tx_cksum, buff, length);
+    iov[0].base = tf->sendbuf;
+    iov[0].len = tf->tx_pos;
+    iov[1].base = buff;
+    iov[1].len = length;
+    if (tf->tx_pos > 0) {
+        TF_WriteImplV(tf, iov, 2);
+    } else {
+        TF_WriteImplV(tf, iov + 1, 1);
+    }
+    tf->tx_pos = 0;
+#else
     uint32_t remain;
     uint32_t chunk;
     uint32_t sent = 0;
@@ -913,10 +3671,11 @@ static void _TF_FN TF_SendFrame_Chunk(TinyFrame *tf, const uint8_t *buff, uint32
 
         // Flush if the buffer is full
         if (tf->tx_pos == TF_SENDBUF_LEN) {
-            TF_WriteImpl(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+            TF_WRITE(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
             tf->tx_pos = 0;
         }
     }
+#endif
 }
 
 /**
@@ -926,21 +3685,73 @@ static void _TF_FN TF_SendFrame_Chunk(TinyFrame *tf, const uint8_t *buff, uint32
  */
 static void _TF_FN TF_SendFrame_End(TinyFrame *tf)
 {
+#if TF_USE_WRITEV
+    TF_IoVec iov;
+#endif
+
     // Checksum only if message had a body
     if (tf->tx_len > 0) {
+#if !TF_USE_WRITEV && !TF_USE_TX_QUEUE
         // Flush if checksum wouldn't fit in the buffer
         if (TF_SENDBUF_LEN - tf->tx_pos < sizeof(TF_CKSUM)) {
-            TF_WriteImpl(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+            TF_WRITE(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
             tf->tx_pos = 0;
         }
+#endif
 
         // Add checksum, flush what remains to be sent
         tf->tx_pos += TF_ComposeTail(tf->sendbuf + tf->tx_pos, &tf->tx_cksum);
     }
 
-    TF_WriteImpl(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+#if TF_USE_TX_QUEUE
+    txq_put(tf, tf->sendbuf, tf->tx_pos);
+    txq_publish(tf);
+#elif TF_USE_WRITEV
+    if (tf->tx_pos > 0) {
+        iov.base = tf->sendbuf;
+        iov.len = tf->tx_pos;
+        TF_WriteImplV(tf, &iov, 1);
+    }
+#else
+    TF_WRITE(tf, (const uint8_t *) tf->sendbuf, tf->tx_pos);
+#endif
+#if TF_USE_COBS
+    cobs_end(tf);
+#endif
+    TF_ReleaseTx(tf);
+}
+
+#if TF_USE_WRITEV
+/**
+ * Send a whole frame body and end the frame - the head, payload and checksum
+ * go to TF_WriteImplV() together, the payload isn't copied.
+ *
+ * @param tf - instance
+ * @param buff - payload
+ * @param length - payload length
+ */
+static void _TF_FN TF_SendFrame_Whole(TinyFrame *tf, const uint8_t *buff, uint32_t length)
+{
+    TF_IoVec iov[3];
+    uint8_t count = 1;
+
+    iov[0].base = tf->sendbuf;
+    iov[0].len = tf->tx_pos;
+
+    if (length > 0) {
+        CKSUM_ADD_BLOCK(tf->tx_cksum, buff, length);
+        iov[1].base = buff;
+        iov[1].len = length;
+        // the checksum goes after the head in the buffer
+        iov[2].base = tf->sendbuf + tf->tx_pos;
+        iov[2].len = TF_ComposeTail(tf->sendbuf + tf->tx_pos, &tf->tx_cksum);
+        count = (uint8_t) (iov[2].len > 0 ? 3 : 2);
+    }
+
+    TF_WriteImplV(tf, iov, count);
     TF_ReleaseTx(tf);
 }
+#endif
 
 /**
  * Send a message
@@ -954,13 +3765,37 @@ static void _TF_FN TF_SendFrame_End(TinyFrame *tf)
  */
 static bool _TF_FN TF_SendFrame(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
 {
-    TF_TRY(TF_SendFrame_Begin(tf, msg, listener, ftimeout, timeout));
+#if TF_USE_COMPRESSION
+    TF_Msg packed;
+
+    if (msg->data != NULL && msg->len >= TF_COMP_THRESHOLD) {
+        // the compression buffer is used under the Tx lock
+        TF_TRY(TF_ClaimTx(tf));
+        if (comp_pack(tf, msg, &packed)) {
+  #if TF_USE_TX_QUEUE
+            packed.priority = txq_priority(msg); // the class of the original type
+  #endif
+            TF_TRY(TF_SendFrame_Start(tf, &packed, listener, ftimeout, timeout));
+            msg->frame_id = packed.frame_id;
+            msg = &packed;
+        } else {
+            TF_TRY(TF_SendFrame_Start(tf, msg, listener, ftimeout, timeout));
+        }
+    } else
+#endif
+    {
+        TF_TRY(TF_SendFrame_Begin(tf, msg, listener, ftimeout, timeout));
+    }
     if (msg->len == 0 || msg->data != NULL) {
         // Send the payload and checksum only if we're not starting a multi-part frame.
         // A multi-part frame is identified by passing NULL to the data field and setting the length.
         // User then needs to call those functions manually
+#if TF_USE_WRITEV
+        TF_SendFrame_Whole(tf, msg->data, msg->len);
+#else
         TF_SendFrame_Chunk(tf, msg->data, msg->len);
         TF_SendFrame_End(tf);
+#endif
     }
     return true;
 }
@@ -1057,29 +3892,588 @@ void _TF_FN TF_Multipart_Close(TinyFrame *tf)
 //endregion Sending API funcs - multipart
 
 
+#if TF_USE_FRAGMENTS
+//region Sending API funcs - fragmented
+
+/**
+ * Send the next fragment of a message
+ *
+ * @param tf - instance
+ * @param ft - the message
+ * @return success
+ */
+static bool _TF_FN frag_tx_send(TinyFrame *tf, struct TF_FragTx_ *ft)
+{
+    int8_t si = 0; // signed small int
+    uint8_t b = 0;
+    uint8_t outbuff[TF_FRAG_HEAD_LEN];
+    uint32_t pos = 0;
+    TF_LEN chunk = (TF_LEN) TF_MIN(ft->msg.len - ft->sent, TF_FRAG_SIZE);
+    bool first = (ft->sent == 0);
+    TF_Msg frag;
+
+    TF_ClearMsg(&frag);
+    frag.type = TF_FRAG_TYPE;
+    frag.frame_id = ft->msg.frame_id;
+    frag.is_response = first ? ft->msg.is_response : true; // all fragments have the ID of the first
+    frag.userdata = ft->msg.userdata;
+    frag.userdata2 = ft->msg.userdata2;
+#if TF_USE_TX_QUEUE
+    frag.priority = ft->msg.priority;
+    if (ft->sent + chunk == ft->msg.len) frag.tx_done = ft->msg.tx_done;
+#endif
+
+    outbuff[pos++] = (uint8_t) ((first ? TF_FRAG_FIRST : 0) | (ft->sent + chunk == ft->msg.len ? TF_FRAG_LAST : 0));
+    if (first) {
+        WRITENUM(TF_TYPE, ft->msg.type);
+        WRITENUM(TF_LEN, ft->msg.len);
+    }
+    frag.len = (TF_LEN) (pos + chunk);
+
+    TF_TRY(TF_SendFrame_Begin(tf, &frag, first ? ft->listener : NULL, ft->ftimeout, ft->timeout));
+    ft->msg.frame_id = frag.frame_id;
+    TF_SendFrame_Chunk(tf, outbuff, pos);
+    TF_SendFrame_Chunk(tf, ft->msg.data + ft->sent, chunk);
+    TF_SendFrame_End(tf);
+
+    ft->sent += chunk;
+    if (ft->sent == ft->msg.len) {
+        ft->used = false;
+    }
+    return true;
+}
+
+/**
+ * Queue a fragmented message
+ *
+ * @param tf - instance
+ * @param msg - message, the data must stay valid until it's sent
+ * @param listener - ID listener, or NULL
+ * @param ftimeout - time out callback
+ * @param timeout - listener timeout, 0 is none
+ * @return success
+ */
+static bool _TF_FN frag_tx_add(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    struct TF_FragTx_ *ft;
+    TF_COUNT i;
+
+    for (i = 0; i < TF_MAX_FRAG_TX; i++) {
+        ft = &tf->frag_tx[i];
+        if (!ft->used) {
+            ft->used = true;
+            ft->msg = *msg;
+#if TF_USE_TX_QUEUE
+            // the fragments have TF_FRAG_TYPE, they get the class of the original type
+            ft->msg.priority = txq_priority(msg);
+#endif
+            ft->sent = 0;
+            ft->listener = listener;
+            ft->ftimeout = ftimeout;
+            ft->timeout = timeout;
+            return true;
+        }
+    }
+
+    TF_Error("Too many fragmented messages");
+    return false;
+}
+
+bool _TF_FN TF_Send_Fragmented(TinyFrame *tf, TF_Msg *msg)
+{
+    return frag_tx_add(tf, msg, NULL, NULL, 0);
+}
+
+bool _TF_FN TF_Query_Fragmented(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout)
+{
+    return frag_tx_add(tf, msg, listener, ftimeout, timeout);
+}
+
+bool _TF_FN TF_Respond_Fragmented(TinyFrame *tf, TF_Msg *msg)
+{
+    msg->is_response = true;
+    return frag_tx_add(tf, msg, NULL, NULL, 0);
+}
+
+/** Send one fragment, taking turns between the messages */
+bool _TF_FN TF_SendNextFragment(TinyFrame *tf)
+{
+    struct TF_FragTx_ *ft;
+    TF_COUNT i;
+    TF_COUNT n;
+
+    for (n = 0; n < TF_MAX_FRAG_TX; n++) {
+        i = tf->frag_tx_next;
+        tf->frag_tx_next = (TF_COUNT) (i + 1 == TF_MAX_FRAG_TX ? 0 : i + 1);
+
+        ft = &tf->frag_tx[i];
+        if (ft->used) {
+            frag_tx_send(tf, ft); // if it fails, it's tried again next time
+            break;
+        }
+    }
+
+    for (i = 0; i < TF_MAX_FRAG_TX; i++) {
+        if (tf->frag_tx[i].used) return true;
+    }
+    return false;
+}
+
+//endregion Sending API funcs - fragmented
+#endif
+
+
+#if TF_USE_RELIABLE
+//region Sending API funcs - reliable
+
+/**
+ * Send (or send again) a message from the reliable window
+ *
+ * @param tf - instance
+ * @param seq - its sequence nr
+ * @return success
+ */
+static bool _TF_FN rel_tx_send(TinyFrame *tf, uint16_t seq)
+{
+    int8_t si = 0; // signed small int
+    uint8_t b = 0;
+    uint8_t outbuff[TF_REL_HEAD_LEN];
+    uint32_t pos = 0;
+    struct TF_RelTx_ *slot = &tf->rel_tx[TF_REL_SLOT(seq)];
+    TF_Msg msg;
+
+    TF_ClearMsg(&msg);
+    msg.type = TF_REL_TYPE;
+    msg.len = (TF_LEN) (TF_REL_HEAD_LEN + slot->len);
+#if TF_USE_TX_QUEUE
+    msg.priority = slot->priority;
+#endif
+
+    outbuff[pos++] = TF_REL_DATA;
+    outbuff[pos++] = (uint8_t) (seq >> 8);
+    outbuff[pos++] = (uint8_t) seq;
+    outbuff[pos++] = (uint8_t) (tf->rel_tx_base >> 8);
+    outbuff[pos++] = (uint8_t) tf->rel_tx_base;
+    WRITENUM(TF_TYPE, slot->type);
+
+    TF_TRY(TF_SendFrame_Begin(tf, &msg, NULL, NULL, 0));
+    slot->frame_id = msg.frame_id;
+    slot->timer = TF_REL_TIMEOUT_TICKS;
+    slot->stamp = tf->rel_tx_stamp++;
+    TF_SendFrame_Chunk(tf, outbuff, pos);
+    TF_SendFrame_Chunk(tf, slot->data, slot->len);
+    TF_SendFrame_End(tf);
+    return true;
+}
+
+/** Send a message with reliable delivery */
+bool _TF_FN TF_SendReliable(TinyFrame *tf, TF_Msg *msg, TF_Listener done)
+{
+    struct TF_RelTx_ *slot;
+    uint16_t seq = tf->rel_tx_next;
+
+    if (msg->len > TF_REL_MAX_LEN) {
+        TF_Error("Reliable message too long: %d", (int)msg->len);
+        return false;
+    }
+    if ((uint16_t) (seq - tf->rel_tx_base) >= TF_REL_WINDOW) {
+        TF_Error("Reliable window full");
+        return false;
+    }
+
+    slot = &tf->rel_tx[TF_REL_SLOT(seq)];
+    slot->done = done;
+    slot->userdata = msg->userdata;
+    slot->userdata2 = msg->userdata2;
+    slot->type = msg->type;
+    slot->len = msg->len;
+    if (msg->len > 0) memcpy(slot->data, msg->data, msg->len);
+    slot->frame_id = 0;
+    slot->timer = 0; // if it can't be sent now, it's sent on the next tick
+    slot->retries = 0;
+    slot->acked = false;
+    slot->failed = false;
+#if TF_USE_TX_QUEUE
+    slot->priority = txq_priority(msg); // the frames have TF_REL_TYPE
+#endif
+    tf->rel_tx_next++;
+
+    if (rel_tx_send(tf, seq)) msg->frame_id = slot->frame_id;
+    return true;
+}
+
+/** Get the nr of reliable messages that can be sent now */
+uint16_t _TF_FN TF_ReliableFree(TinyFrame *tf)
+{
+    return (uint16_t) (TF_REL_WINDOW - (uint16_t) (tf->rel_tx_next - tf->rel_tx_base));
+}
+
+/**
+ * Count down the retransmit timers, send again the messages whose timers ran out
+ * and the ack, if one is due
+ *
+ * @param tf - instance
+ * @param elapsed - ticks since the last call
+ */
+static void _TF_FN rel_tick(TinyFrame *tf, TF_TICKS elapsed)
+{
+    struct TF_RelTx_ *slot;
+    uint16_t seq;
+
+    // callbacks may release messages meanwhile, stop at the start of the window
+    for (seq = tf->rel_tx_base;
+         (uint16_t) (seq - tf->rel_tx_base) < (uint16_t) (tf->rel_tx_next - tf->rel_tx_base);
+         seq++) {
+        slot = &tf->rel_tx[TF_REL_SLOT(seq)];
+        if (slot->acked) continue;
+
+        if (elapsed < slot->timer) {
+            slot->timer = (TF_TICKS) (slot->timer - elapsed);
+            continue;
+        }
+
+        if (slot->retries >= TF_REL_RETRIES) {
+            TF_Error("Reliable message %d not delivered", (int)seq);
+            slot->acked = true;
+            slot->failed = true;
+            continue;
+        }
+
+        slot->timer = 0;
+        if (rel_tx_send(tf, seq)) slot->retries++;
+    }
+
+    rel_tx_release(tf);
+
+    if (tf->rel_ack_due) rel_ack(tf);
+}
+
+//endregion Sending API funcs - reliable
+#endif
+
+
+#if TF_USE_MPSC_TX
+//region Lock-free submission
+
+/** Encode a whole frame to a buffer, without the Tx lock */
+uint32_t _TF_FN TF_EncodeFrame(TinyFrame *tf, TF_Msg *msg, uint8_t *buf, uint32_t size)
+{
+    TF_CKSUM cksum;
+    uint32_t pos;
+
+    if (size < TF_HEAD_LEN + msg->len + (msg->len > 0 ? TF_CKSUM_LEN : 0)) {
+        TF_Error("TF_EncodeFrame() - buffer too small for %d bytes", (int)msg->len);
+        return 0;
+    }
+
+    pos = TF_ComposeHead(tf, buf, msg); // the frame ID is taken atomically
+    if (msg->len > 0) {
+        CKSUM_RESET(cksum);
+        pos += TF_ComposeBody(buf + pos, msg->data, msg->len, &cksum);
+        pos += TF_ComposeTail(buf + pos, &cksum);
+    }
+    return pos;
+}
+
+/** Publish an encoded frame to the writer */
+void _TF_FN TF_Submit(TinyFrame *tf, TF_TxNode *node)
+{
+    TF_TxNode *prev;
+
+    node->next = NULL;
+    prev = __atomic_exchange_n(&tf->mpsc_head, node, __ATOMIC_ACQ_REL);
+    // the node is reachable once linked to its predecessor - until then the writer waits for it
+    TF_ATOMIC_STORE(&prev->next, node);
+}
+
+/**
+ * Take the oldest submitted frame (intrusive MPSC queue, the consumer side)
+ *
+ * @param tf - instance
+ * @return the node, NULL if none is ready
+ */
+static TF_TxNode * _TF_FN mpsc_pop(TinyFrame *tf)
+{
+    TF_TxNode *tail = tf->mpsc_tail;
+    TF_TxNode *next = TF_ATOMIC_LOAD(&tail->next);
+
+    // skip the stub
+    if (tail == &tf->mpsc_stub) {
+        if (next == NULL) return NULL;
+        tf->mpsc_tail = next;
+        tail = next;
+        next = TF_ATOMIC_LOAD(&tail->next);
+    }
+
+    if (next != NULL) {
+        tf->mpsc_tail = next;
+        return tail;
+    }
+
+    // tail is the last node, or a producer is between the exchange and the link
+    if (tail != TF_ATOMIC_LOAD(&tf->mpsc_head)) return NULL;
+
+    // put the stub behind it, so it can be taken out
+    TF_Submit(tf, &tf->mpsc_stub);
+    next = TF_ATOMIC_LOAD(&tail->next);
+    if (next != NULL) {
+        tf->mpsc_tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/** Write submitted frames, called by the single writer */
+uint32_t _TF_FN TF_WriteSubmitted(TinyFrame *tf, uint32_t max)
+{
+    TF_TxNode *node;
+    uint32_t n = 0;
+#if TF_USE_WRITEV
+    TF_IoVec iov;
+#endif
+
+    while (max == 0 || n < max) {
+        // wait for TF_Send() etc. from other threads, if there are any. Without a real
+        // mutex the claim fails instead - the frames stay queued for the next call.
+        if (!TF_ClaimTx(tf)) break;
+
+        node = mpsc_pop(tf);
+        if (node == NULL) {
+            TF_ReleaseTx(tf);
+            break;
+        }
+
+#if TF_USE_WRITEV
+        iov.base = node->data;
+        iov.len = node->len;
+        TF_WriteImplV(tf, &iov, 1);
+#else
+        TF_WriteImpl(tf, node->data, node->len);
+#endif
+        TF_ReleaseTx(tf);
+
+        // the node is the producer's again
+        if (node->done != NULL) {
+            node->done(tf, node);
+        }
+        n++;
+    }
+
+    return n;
+}
+
+//endregion Lock-free submission
+#endif
+
+
 /** Timebase hook - for timeouts */
 void _TF_FN TF_Tick(TinyFrame *tf)
+{
+    TF_TickBy(tf, 1);
+}
+
+/** Timebase hook - for timeouts, when some ticks may have been skipped */
+void _TF_FN TF_TickBy(TinyFrame *tf, TF_TICKS elapsed)
 {
     TF_COUNT i;
     struct TF_IdListener_ *lst;
+#if TF_USE_TIMER_WHEEL
+    TF_COUNT next;
+    TF_COUNT expiring = 0; // chain of listeners to expire
+    TF_TICKS start = tf->ticks;
+    uint32_t k, buckets;
+#endif
+
+    if (elapsed == 0) return;
+
+#if TF_USE_FLOW_CONTROL
+    // out of credit for a while - maybe frames or grants were lost, ask the peer
+    if (TF_ATOMIC_LOAD(&tf->flow_blocked)) {
+        if (elapsed < TF_FLOW_PROBE_TICKS - tf->flow_probe_ticks) {
+            tf->flow_probe_ticks = (TF_TICKS) (tf->flow_probe_ticks + elapsed);
+        }
+        else if (flow_send(tf, TF_FLOW_PROBE, tf->flow_tx_frames, tf->flow_tx_bytes)) {
+            tf->flow_probe_ticks = 0;
+        }
+    }
+#endif
+
+#if TF_USE_RELIABLE
+    rel_tick(tf, elapsed);
+#endif
 
     // increment parser timeout (timeout is handled when receiving next byte)
-    if (tf->parser_timeout_ticks < TF_PARSER_TIMEOUT_TICKS) {
-        tf->parser_timeout_ticks++;
+    if (elapsed < TF_PARSER_TIMEOUT_TICKS - tf->parser_timeout_ticks) {
+        tf->parser_timeout_ticks = (TF_TICKS) (tf->parser_timeout_ticks + elapsed);
+    }
+    else {
+        tf->parser_timeout_ticks = TF_PARSER_TIMEOUT_TICKS;
+    }
+
+#if TF_USE_TIMER_WHEEL
+    tf->ticks = (TF_TICKS) (start + elapsed);
+
+    // collect ID listeners due by now - buckets also have ones due in later turns of the wheel
+    buckets = elapsed < TF_TIMER_WHEEL_SIZE ? elapsed : TF_TIMER_WHEEL_SIZE;
+    for (k = 1; k <= buckets; k++) {
+        next = tf->wheel[(start + k) & TF_WHEEL_MASK];
+        while (next != 0) {
+            i = (TF_COUNT) (next - 1);
+            lst = &tf->id_listeners[i];
+            next = lst->wheel_next;
+
+            // deadline in (start, start + elapsed]
+            if ((TF_TICKS) (lst->deadline - start - 1) < elapsed) {
+                wheel_unlink(tf, i);
+                lst->wheel_state = TF_WHEEL_EXPIRING;
+                lst->expire_next = expiring;
+                expiring = (TF_COUNT) (i + 1);
+            }
+        }
     }
 
+    // expire them - the timeout functions may remove or renew some, those are skipped
+    while (expiring != 0) {
+        i = (TF_COUNT) (expiring - 1);
+        lst = &tf->id_listeners[i];
+        expiring = lst->expire_next;
+
+        if (lst->wheel_state != TF_WHEEL_EXPIRING) continue;
+        lst->wheel_state = TF_WHEEL_IDLE;
+
+        TF_Error("ID listener %d has expired", (int)lst->id);
+        if (lst->fn_timeout != NULL) {
+            lst->fn_timeout(tf); // execute timeout function
+            lst = &tf->id_listeners[i]; // the table may have grown (moved) meanwhile
+        }
+        // Listener has expired
+        cleanup_id_listener(tf, i, lst);
+    }
+#else
     // decrement and expire ID listeners
     for (i = 0; i < tf->count_id_lst; i++) {
         lst = &tf->id_listeners[i];
         if (!lst->fn || lst->timeout == 0) continue;
         // count down...
-        if (--lst->timeout == 0) {
+        if (lst->timeout <= elapsed) {
+            lst->timeout = 0;
             TF_Error("ID listener %d has expired", (int)lst->id);
             if (lst->fn_timeout != NULL) {
                 lst->fn_timeout(tf); // execute timeout function
+                lst = &tf->id_listeners[i]; // the table may have grown (moved) meanwhile
             }
             // Listener has expired
             cleanup_id_listener(tf, i, lst);
         }
+        else {
+            lst->timeout = (TF_TICKS) (lst->timeout - elapsed);
+        }
+    }
+#endif
+}
+
+/** Get the nr of ticks until an ID listener expires */
+TF_TICKS _TF_FN TF_NextDeadline(TinyFrame *tf)
+{
+    TF_TICKS best = 0;
+    TF_TICKS remain;
+    TF_COUNT i;
+    struct TF_IdListener_ *lst;
+#if TF_USE_RELIABLE
+    struct TF_RelTx_ *slot;
+    uint16_t seq;
+#endif
+#if TF_USE_TIMER_WHEEL
+    TF_COUNT next;
+    uint32_t k;
+
+    // Walk the wheel from the next tick. A listener found in the k-th bucket is due in k ticks,
+    // or in a later turn of the wheel - the first one due in its own turn is the nearest.
+    for (k = 1; k <= TF_TIMER_WHEEL_SIZE; k++) {
+        next = tf->wheel[(tf->ticks + k) & TF_WHEEL_MASK];
+        while (next != 0) {
+            i = (TF_COUNT) (next - 1);
+            lst = &tf->id_listeners[i];
+            next = lst->wheel_next;
+
+            remain = (TF_TICKS) (lst->deadline - tf->ticks);
+            if (best == 0 || remain < best) {
+                best = remain;
+            }
+        }
+        if (best != 0 && best <= k) break;
+    }
+#else
+    for (i = 0; i < tf->count_id_lst; i++) {
+        lst = &tf->id_listeners[i];
+        if (!lst->fn || lst->timeout == 0) continue;
+
+        remain = lst->timeout;
+        if (best == 0 || remain < best) {
+            best = remain;
+        }
+    }
+#endif
+
+#if TF_USE_RELIABLE
+    // messages to send again - a timer of 0 means it couldn't be sent, it's tried on the next tick
+    for (seq = tf->rel_tx_base; seq != tf->rel_tx_next; seq++) {
+        slot = &tf->rel_tx[TF_REL_SLOT(seq)];
+        if (slot->acked) continue; // also the given up ones
+
+        remain = slot->timer ? slot->timer : 1;
+        if (best == 0 || remain < best) {
+            best = remain;
+        }
+    }
+    if (tf->rel_ack_due) best = 1;
+#endif
+
+#if TF_USE_FLOW_CONTROL
+    // a blocked sender asks for credit
+    if (TF_ATOMIC_LOAD(&tf->flow_blocked)) {
+        remain = (TF_TICKS) (tf->flow_probe_ticks < TF_FLOW_PROBE_TICKS ? TF_FLOW_PROBE_TICKS - tf->flow_probe_ticks : 1);
+        if (best == 0 || remain < best) {
+            best = remain;
+        }
+    }
+#endif
+    return best;
+}
+
+#if TF_TICK_MS
+/** Timebase hook - with a millisecond clock */
+void _TF_FN TF_TickMs(TinyFrame *tf, uint32_t now_ms)
+{
+    uint32_t ticks, step;
+
+    if (!tf->ms_started) {
+        tf->ms_base = now_ms;
+        tf->ms_started = true;
+        return;
+    }
+
+    ticks = (now_ms - tf->ms_base) / TF_TICK_MS;
+    tf->ms_base += ticks * TF_TICK_MS; // the remainder counts towards the next tick
+
+    // TF_TICKS can be too small for a long sleep
+    while (ticks > 0) {
+        step = ticks < (TF_TICKS) -1 ? ticks : (TF_TICKS) -1;
+        TF_TickBy(tf, (TF_TICKS) step);
+        ticks -= step;
     }
 }
+
+/** Get the nr of milliseconds until an ID listener expires */
+uint32_t _TF_FN TF_NextDeadlineMs(TinyFrame *tf, uint32_t now_ms)
+{
+    TF_TICKS ticks = TF_NextDeadline(tf);
+    int32_t remain;
+
+    if (ticks == 0) return 0;
+    if (!tf->ms_started) return (uint32_t) ticks * TF_TICK_MS;
+
+    remain = (int32_t) (tf->ms_base + (uint32_t) ticks * TF_TICK_MS - now_ms);
+    return remain > 0 ? (uint32_t) remain : 1;
+}
+#endif
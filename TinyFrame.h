@@ -19,16 +19,26 @@
 #include <string.h>  // for memset()
 //---------------------------------------------------------------------------
 
-// Checksum type (0 = none, 8 = ~XOR, 16 = CRC16 0x8005, 32 = CRC32)
+// Checksum type (0 = none, 8 = ~XOR, 16 = CRC16 0x8005, 32 = CRC32, 33 = CRC32C)
 #define TF_CKSUM_NONE  0  // no checksums
 #define TF_CKSUM_XOR   8  // inverted xor of all payload bytes
 #define TF_CKSUM_CRC8  9  // Dallas/Maxim CRC8 (1-wire)
 #define TF_CKSUM_CRC16 16 // CRC16 with the polynomial 0x8005 (x^16 + x^15 + x^2 + 1)
 #define TF_CKSUM_CRC32 32 // CRC32 with the polynomial 0xedb88320
+#define TF_CKSUM_CRC32C 33 // CRC32C (Castagnoli) with the polynomial 0x82f63b78
 #define TF_CKSUM_CUSTOM8  1  // Custom 8-bit checksum
 #define TF_CKSUM_CUSTOM16 2  // Custom 16-bit checksum
 #define TF_CKSUM_CUSTOM32 3  // Custom 32-bit checksum
 
+// Type listener lookup strategy (TF_TYPE_DISPATCH)
+#define TF_TYPE_DISPATCH_LINEAR 0 // scan the listener table
+#define TF_TYPE_DISPATCH_SORTED 1 // binary search in a list of listeners sorted by type
+#define TF_TYPE_DISPATCH_DIRECT 2 // table indexed by type, only for TF_TYPE_BYTES == 1
+
+// TX queue scheduling between priority classes (TF_TX_SCHED)
+#define TF_TX_SCHED_STRICT   0 // the most urgent class with a frame goes first
+#define TF_TX_SCHED_WEIGHTED 1 // classes take turns, sending up to their weight in frames
+
 #include "TF_Config.h"
 
 //region Resolve data types
@@ -72,13 +82,104 @@
 #elif (TF_CKSUM_TYPE == TF_CKSUM_CRC16) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM16)
     // CRC16
     typedef uint16_t TF_CKSUM;
-#elif (TF_CKSUM_TYPE == TF_CKSUM_CRC32) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM32)
+#elif (TF_CKSUM_TYPE == TF_CKSUM_CRC32) || (TF_CKSUM_TYPE == TF_CKSUM_CRC32C) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM32)
     // CRC32
     typedef uint32_t TF_CKSUM;
 #else
     #error Bad value for TF_CKSUM_TYPE
 #endif
 
+#if TF_USE_RESYNC && !TF_USE_SOF_BYTE
+    #error TF_USE_RESYNC requires TF_USE_SOF_BYTE
+#endif
+
+// COBS encoder buffer - it holds an open group of up to 255 bytes, and sends the rest
+#define TF_COBS_BUF_LEN (TF_SENDBUF_LEN + 256)
+
+#if TF_USE_COBS && TF_USE_SOF_BYTE
+    #error TF_USE_COBS replaces the SOF byte, set TF_USE_SOF_BYTE to 0
+#endif
+
+#if TF_USE_COBS && (TF_USE_WRITEV || TF_USE_TX_QUEUE || TF_USE_MPSC_TX)
+    #error TF_USE_COBS is not supported with TF_USE_WRITEV, TF_USE_TX_QUEUE or TF_USE_MPSC_TX
+#endif
+
+// Largest nr of bytes the LEN and TYPE fields take in the frame head
+#if TF_USE_VARINT
+    #define TF_LEN_FIELD_MAX  ((TF_LEN_BYTES * 8 + 6) / 7)
+    #define TF_TYPE_FIELD_MAX ((TF_TYPE_BYTES * 8 + 6) / 7)
+#else
+    #define TF_LEN_FIELD_MAX  TF_LEN_BYTES
+    #define TF_TYPE_FIELD_MAX TF_TYPE_BYTES
+#endif
+
+#if TF_USE_ID_HASH && !TF_USE_DYNAMIC_LST && (((TF_ID_HASH_SIZE) & ((TF_ID_HASH_SIZE) - 1)) != 0 || (TF_ID_HASH_SIZE) <= (TF_MAX_ID_LST))
+    #error TF_ID_HASH_SIZE must be a power of two larger than TF_MAX_ID_LST
+#endif
+
+#if TF_USE_TIMER_WHEEL && ((TF_TIMER_WHEEL_SIZE) & ((TF_TIMER_WHEEL_SIZE) - 1)) != 0
+    #error TF_TIMER_WHEEL_SIZE must be a power of two
+#endif
+
+#if TF_USE_WRITEV && (TF_SENDBUF_LEN) < 1 + TF_ID_BYTES + TF_LEN_FIELD_MAX + TF_TYPE_FIELD_MAX + 2 * 4
+    #error TF_SENDBUF_LEN is too small to hold the frame head and checksum
+#endif
+
+#if TF_USE_TX_QUEUE && ((TF_TX_QUEUE_LEN) & ((TF_TX_QUEUE_LEN) - 1)) != 0
+    #error TF_TX_QUEUE_LEN must be a power of two
+#endif
+
+#if TF_USE_TX_QUEUE && TF_USE_WRITEV
+    #error TF_USE_TX_QUEUE and TF_USE_WRITEV are mutually exclusive
+#endif
+
+#if TF_USE_TX_QUEUE && ((TF_TX_PRIORITIES) < 1 || (TF_TX_PRIORITIES) > 255)
+    #error TF_TX_PRIORITIES must be 1 to 255
+#endif
+
+#if TF_USE_TX_QUEUE && TF_TX_SCHED > TF_TX_SCHED_WEIGHTED
+    #error Bad value for TF_TX_SCHED
+#endif
+
+#if TF_USE_MPSC_TX && TF_USE_TX_QUEUE
+    #error TF_USE_MPSC_TX and TF_USE_TX_QUEUE are mutually exclusive
+#endif
+
+#if TF_USE_FLOW_CONTROL && (TF_FLOW_FRAMES) < 1
+    #error TF_FLOW_FRAMES must be at least 1
+#endif
+
+#if TF_USE_FLOW_CONTROL && TF_USE_MPSC_TX
+    #error TF_USE_FLOW_CONTROL and TF_USE_MPSC_TX are mutually exclusive
+#endif
+
+#if TF_USE_FRAGMENTS && (TF_FRAG_SIZE) + 1 + TF_TYPE_BYTES + TF_LEN_BYTES > (TF_MAX_PAYLOAD_RX)
+    #error TF_FRAG_SIZE is too large, a fragment must fit in TF_MAX_PAYLOAD_RX
+#endif
+
+#if TF_USE_RELIABLE && ((TF_REL_WINDOW) < 1 || (TF_REL_WINDOW) > 32 || ((TF_REL_WINDOW) & ((TF_REL_WINDOW) - 1)) != 0)
+    #error TF_REL_WINDOW must be 1, 2, 4, 8, 16 or 32
+#endif
+
+#if TF_USE_RELIABLE && (TF_REL_MAX_LEN) + 5 + TF_TYPE_BYTES > (TF_MAX_PAYLOAD_RX)
+    #error TF_REL_MAX_LEN is too large, a reliable message must fit in TF_MAX_PAYLOAD_RX
+#endif
+
+#if TF_USE_COMPRESSION && (TF_COMP_THRESHOLD) < 16
+    // the library's own short control frames must not be compressed
+    #error TF_COMP_THRESHOLD must be at least 16
+#endif
+
+#if TF_USE_COMPRESSION && ((TF_COMP_MAX_LEN) > 65535 || (TF_COMP_HASH_BITS) < 4 || (TF_COMP_HASH_BITS) > 16)
+    #error TF_COMP_MAX_LEN must be at most 65535, TF_COMP_HASH_BITS 4 to 16
+#endif
+
+#if TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_DIRECT && TF_TYPE_BYTES != 1
+    #error TF_TYPE_DISPATCH_DIRECT requires TF_TYPE_BYTES == 1
+#elif TF_TYPE_DISPATCH > TF_TYPE_DISPATCH_DIRECT
+    #error Bad value for TF_TYPE_DISPATCH
+#endif
+
 //endregion
 
 //---------------------------------------------------------------------------
@@ -99,6 +200,28 @@ typedef enum {
 } TF_Result;
 
 
+#if TF_USE_TX_QUEUE
+/**
+ * TX completion callback, see TF_Msg.tx_done
+ *
+ * @param tf - instance
+ * @param frame_id - ID of the sent frame
+ * @param userdata - userdata of the sent message
+ */
+struct TinyFrame_;
+typedef void (*TF_TxCallback)(struct TinyFrame_ *tf, TF_ID frame_id, void *userdata);
+
+#if TF_TX_STATS
+/** Statistics of a TX priority class, see TF_TxGetStats() */
+typedef struct TF_TxStats_ {
+    uint32_t frames;     //!< Nr of frames sent
+    uint32_t bytes;      //!< Nr of bytes sent in them
+    uint32_t delay_max;  //!< Longest time from sending a frame until it left the queue (TF_TxTimestamp() units)
+    uint64_t delay_sum;  //!< Sum of those times, divide by frames for the average
+} TF_TxStats;
+#endif
+#endif
+
 /** Data structure for sending / receiving messages */
 typedef struct TF_Msg_ {
     TF_ID frame_id;       //!< message ID
@@ -113,6 +236,9 @@ typedef struct TF_Msg_ {
      *
      * - If (data == NULL) and length is not zero when sending a frame, that starts a multi-part frame.
      *   This call then must be followed by sending the payload and closing the frame.
+     *
+     * - Received data is only valid during the listener call. With TF_USE_ZEROCOPY_RX,
+     *   it may point into the buffer given to TF_Accept().
      */
     const uint8_t *data;
     TF_LEN len; //!< length of the payload
@@ -125,6 +251,20 @@ typedef struct TF_Msg_ {
      */
     void *userdata;
     void *userdata2;
+
+#if TF_USE_TX_QUEUE
+    /**
+     * Called from TF_TxComplete() when the frame has been sent, or NULL.
+     * Gets the userdata field.
+     */
+    TF_TxCallback tx_done;
+
+    /**
+     * Priority class in the TX queue, 0 to TF_TX_PRIORITIES - 1, higher is more urgent.
+     * TF_TX_TYPE_PRIORITY(type) is used instead if it's higher.
+     */
+    uint8_t priority;
+#endif
 } TF_Msg;
 
 /**
@@ -158,6 +298,83 @@ typedef TF_Result (*TF_Listener)(TinyFrame *tf, TF_Msg *msg);
  */
 typedef TF_Result (*TF_Listener_Timeout)(TinyFrame *tf);
 
+#if TF_USE_MPSC_TX
+/**
+ * An encoded frame submitted with TF_Submit(). The node and the frame buffer
+ * belong to the submitting thread - it can reuse them after done is called.
+ */
+typedef struct TF_TxNode_ {
+    struct TF_TxNode_ *next; //!< Internal, queue link
+    const uint8_t *data;     //!< The frame, from TF_EncodeFrame()
+    uint32_t len;            //!< Frame length
+    /** Called by the writer when the frame has been written, or NULL */
+    void (*done)(TinyFrame *tf, struct TF_TxNode_ *node);
+    void *userdata;
+} TF_TxNode;
+#endif
+
+#if TF_USE_STREAM_RX
+/** Events passed to a stream listener */
+typedef enum {
+    TF_STREAM_DATA = 0,  //!< A piece of the payload, in msg->data and msg->len
+    TF_STREAM_END = 1,   //!< The frame is complete and the checksum matched. msg->len is the total length.
+    TF_STREAM_ERROR = 2, //!< Checksum mismatch or the frame was cut off - discard what was received
+} TF_StreamEvent;
+
+/**
+ * TinyFrame Stream Listener callback
+ *
+ * @param tf - instance
+ * @param msg - frame ID and type, payload chunk for TF_STREAM_DATA (data is NULL otherwise)
+ * @param event - what happened
+ * @param offset - position of the chunk in the payload (for TF_STREAM_DATA), or nr of bytes received so far
+ */
+typedef void (*TF_StreamListener)(TinyFrame *tf, TF_Msg *msg, TF_StreamEvent event, TF_LEN offset);
+#endif
+
+#if TF_USE_WRITEV
+/**
+ * A piece of an outgoing frame, for TF_WriteImplV(). Like struct iovec.
+ */
+typedef struct TF_IoVec_ {
+    const uint8_t *base;  //!< Bytes to send
+    uint32_t len;         //!< Nr of bytes
+} TF_IoVec;
+#endif
+
+#if TF_USE_RX_POOL
+/**
+ * Shared pool of RX buffers, see TF_RxPoolInit()
+ */
+typedef struct TF_RxPool_ TF_RxPool;
+
+/**
+ * One size class of a RX buffer pool. The counters can be read with TF_RxPoolGetStats().
+ */
+typedef struct TF_RxPoolClass_ {
+    uint8_t *free;        //!< First free buffer, each free buffer holds a pointer to the next one
+    TF_LEN size;          //!< Size of the buffers
+    uint16_t count;       //!< Nr of buffers
+    uint16_t in_use;      //!< Nr of buffers currently taken
+    uint16_t peak;        //!< Highest in_use seen
+    uint32_t exhausted;   //!< Nr of times a frame wanted this class, but it was empty
+} TF_RxPoolClass;
+
+struct TF_RxPool_ {
+    TF_RxPoolClass classes[TF_RX_POOL_CLASSES]; //!< Size classes, from the smallest
+    uint8_t class_count;  //!< Nr of classes added
+    uint32_t failed;      //!< Nr of frames dropped because no buffer was free
+
+    /**
+     * Optional lock, needed if the pool is shared by instances running in different threads.
+     * Set those after TF_RxPoolInit().
+     */
+    void (*lock)(TF_RxPool *pool);
+    void (*unlock)(TF_RxPool *pool);
+    void *userdata;
+};
+#endif
+
 // ---------------------------------- INIT ------------------------------
 
 /**
@@ -181,6 +398,8 @@ TinyFrame *TF_Init(TF_Peer peer_bit);
  * Initialize the TinyFrame engine using a statically allocated instance struct.
  *
  * The .userdata / .usertag field is preserved when TF_InitStatic is called.
+ * To reset an instance that was used with TF_USE_DYNAMIC_LST or an RX pool, call
+ * TF_DeInitStatic() first - the listener tables would leak otherwise.
  *
  * @param tf - instance
  * @param peer_bit - peer bit to use for self
@@ -195,6 +414,58 @@ bool TF_InitStatic(TinyFrame *tf, TF_Peer peer_bit);
  */
 void TF_DeInit(TinyFrame *tf);
 
+/**
+ * De-init an instance set up with TF_InitStatic(): free the listener tables
+ * (TF_USE_DYNAMIC_LST) and return the RX buffers to the pool. The struct itself
+ * is not freed; TF_InitStatic() can be called on it again.
+ *
+ * @param tf - instance
+ */
+void TF_DeInitStatic(TinyFrame *tf);
+
+#if TF_USE_RX_POOL
+/**
+ * Initialize a shared RX buffer pool.
+ *
+ * With TF_USE_RX_POOL, instances have no RX buffer of their own. When a frame header
+ * is received, a buffer of the smallest fitting size class is taken from the pool,
+ * and it's returned when the frame was handled by the listeners.
+ *
+ * @param pool - pool to initialize
+ */
+void TF_RxPoolInit(TF_RxPool *pool);
+
+/**
+ * Add a size class to a pool. Classes must be added from the smallest.
+ *
+ * @param pool - pool
+ * @param storage - memory for the buffers, size * count bytes
+ * @param size - buffer size, at least sizeof(void *)
+ * @param count - nr of buffers
+ * @return success
+ */
+bool TF_RxPoolAddClass(TF_RxPool *pool, uint8_t *storage, TF_LEN size, uint16_t count);
+
+/**
+ * Get a snapshot of a size class's usage counters
+ *
+ * @param pool - pool
+ * @param class_index - index of the class, in the order they were added
+ * @param stats - the class is copied here
+ * @return success (false if there's no such class)
+ */
+bool TF_RxPoolGetStats(TF_RxPool *pool, uint8_t class_index, TF_RxPoolClass *stats);
+
+/**
+ * Let an instance take its RX buffers from a pool. Frames with a payload
+ * are dropped until a pool is set.
+ *
+ * @param tf - instance
+ * @param pool - pool to use
+ */
+void TF_SetRxPool(TinyFrame *tf, TF_RxPool *pool);
+#endif
+
 
 // ---------------------------------- API CALLS --------------------------------------
 
@@ -220,6 +491,8 @@ void TF_AcceptChar(TinyFrame *tf, uint8_t c);
  * The time base is used to time-out partial frames in the parser and
  * automatically reset it.
  * It's also used to expire ID listeners if a timeout is set when registering them.
+ * With TF_USE_TIMER_WHEEL, a tick only visits the listeners in one wheel bucket
+ * instead of all of them.
  *
  * A common place to call this from is the SysTick handler.
  *
@@ -227,6 +500,54 @@ void TF_AcceptChar(TinyFrame *tf, uint8_t c);
  */
 void TF_Tick(TinyFrame *tf);
 
+/**
+ * Same as calling TF_Tick() 'elapsed' times, for use without a fixed rate timer:
+ * sleep until TF_NextDeadline(), or until some bytes arrive, then catch up with this.
+ *
+ * Call it before TF_Accept() when bytes arrive, so the parser timeout is applied correctly.
+ * ID listeners that expire are handled in one go (not necessarily in the order of their deadlines).
+ *
+ * @param tf - instance
+ * @param elapsed - nr of ticks since the last TF_Tick() / TF_TickBy()
+ */
+void TF_TickBy(TinyFrame *tf, TF_TICKS elapsed);
+
+/**
+ * Get the nr of ticks until TF_TickBy() has work to do: an ID listener expires,
+ * (with TF_USE_RELIABLE) a message is sent again or an ack is due, or (with
+ * TF_USE_FLOW_CONTROL) a blocked sender asks the peer for credit.
+ * The parser timeout needs no wake-up, it's checked when the next byte arrives.
+ *
+ * @param tf - instance
+ * @return nr of ticks (at least 1), 0 if nothing is pending
+ */
+TF_TICKS TF_NextDeadline(TinyFrame *tf);
+
+#if TF_TICK_MS
+/** Convert milliseconds to ticks for listener timeouts (rounds up) */
+#define TF_MS_TO_TICKS(ms) ((TF_TICKS) (((ms) + TF_TICK_MS - 1) / TF_TICK_MS))
+
+/**
+ * Timebase hook using a monotonic millisecond clock (e.g. a SysTick counter,
+ * or CLOCK_MONOTONIC), instead of calling TF_Tick() every TF_TICK_MS milliseconds.
+ * Calls TF_TickBy() with the nr of whole ticks since the last call, the remainder
+ * is kept for the next one. The first call only records the time.
+ *
+ * @param tf - instance
+ * @param now_ms - current time (may wrap around)
+ */
+void TF_TickMs(TinyFrame *tf, uint32_t now_ms);
+
+/**
+ * Get the time until the next ID listener expires - sleep this long, then call TF_TickMs().
+ *
+ * @param tf - instance
+ * @param now_ms - current time
+ * @return milliseconds (at least 1), 0 if no listener has a timeout
+ */
+uint32_t TF_NextDeadlineMs(TinyFrame *tf, uint32_t now_ms);
+#endif
+
 /**
  * Reset the frame parser state machine.
  * This does not affect registered listeners.
@@ -235,6 +556,22 @@ void TF_Tick(TinyFrame *tf);
  */
 void TF_ResetParser(TinyFrame *tf);
 
+#if TF_USE_RX_QUEUE
+/**
+ * Run the listeners for received messages.
+ *
+ * With TF_USE_RX_QUEUE, the parser only puts finished frames to a queue, and the listeners
+ * are called from here instead. The parser and this function may run in different threads
+ * (one each), without locking. Listeners should be added and removed in the thread that
+ * calls this function. Stream listeners are still called from the parser.
+ *
+ * @param tf - instance
+ * @param max - max nr of messages to handle, 0 = all queued
+ * @return nr of messages handled
+ */
+uint32_t TF_DispatchPending(TinyFrame *tf, uint32_t max);
+#endif
+
 
 // ---------------------------- MESSAGE LISTENERS -------------------------------
 
@@ -293,6 +630,30 @@ bool TF_AddGenericListener(TinyFrame *tf, TF_Listener cb);
  */
 bool TF_RemoveGenericListener(TinyFrame *tf, TF_Listener cb);
 
+#if TF_USE_STREAM_RX
+/**
+ * Register a stream listener for a frame type.
+ *
+ * Frames of this type are not buffered, their payload is passed to the listener
+ * in pieces as it arrives, so it can be longer than TF_MAX_PAYLOAD_RX.
+ * Stream listeners take precedence over all other listeners for their type.
+ *
+ * @param tf - instance
+ * @param frame_type - frame type to listen for
+ * @param cb - callback
+ * @return success
+ */
+bool TF_AddStreamListener(TinyFrame *tf, TF_TYPE frame_type, TF_StreamListener cb);
+
+/**
+ * Remove a stream listener by type.
+ *
+ * @param tf - instance
+ * @param type - the type it's registered for
+ */
+bool TF_RemoveStreamListener(TinyFrame *tf, TF_TYPE type);
+#endif
+
 /**
  * Renew an ID listener timeout externally (as opposed to by returning TF_RENEW from the ID listener)
  *
@@ -349,6 +710,70 @@ bool TF_QuerySimple(TinyFrame *tf, TF_TYPE type,
 bool TF_Respond(TinyFrame *tf, TF_Msg *msg);
 
 
+#if TF_USE_TX_QUEUE
+/**
+ * Get queued bytes to send.
+ *
+ * With TF_USE_TX_QUEUE, frames are not written with TF_WriteImpl(), but encoded
+ * to a queue, and sent by the application when the link is ready - e.g. by a DMA
+ * transfer, or a non-blocking write() to a socket. The bytes stay queued until
+ * they are confirmed with TF_TxComplete(), so this returns the same bytes until then.
+ *
+ * This and TF_TxComplete() may run in a different thread (or interrupt) than
+ * the sending functions, without locking.
+ *
+ * @param tf - instance
+ * @param data - set to the first byte to send
+ * @param space - max nr of bytes to get
+ * @return nr of bytes at data, 0 if nothing is queued. Can be fewer than queued
+ *         when the queue wraps around, the rest is returned after TF_TxComplete().
+ */
+uint32_t TF_TxDrain(TinyFrame *tf, const uint8_t **data, uint32_t space);
+
+/**
+ * Confirm bytes from TF_TxDrain() were sent, freeing their space in the queue.
+ * Completion callbacks (TF_Msg.tx_done) of frames sent completely are called from here.
+ *
+ * @param tf - instance
+ * @param n - nr of bytes sent
+ */
+void TF_TxComplete(TinyFrame *tf, uint32_t n);
+
+#if TF_TX_SCHED == TF_TX_SCHED_WEIGHTED
+/**
+ * Set the share of the link a priority class gets with TF_TX_SCHED_WEIGHTED.
+ * In each round, every class sends up to its weight in frames, the most urgent first.
+ * All weights are 1 after init. Set them before frames are sent.
+ *
+ * @param tf - instance
+ * @param priority - priority class
+ * @param weight - nr of frames per round (at least 1)
+ */
+void TF_TxSetWeight(TinyFrame *tf, uint8_t priority, uint16_t weight);
+#endif
+
+#if TF_TX_STATS
+/**
+ * Get the statistics of a priority class - frames sent and their queueing delay,
+ * measured from TF_Send() etc. until TF_TxComplete() confirmed the frame's last byte.
+ * The counters are updated by TF_TxComplete(), read them from the same thread.
+ *
+ * @param tf - instance
+ * @param priority - priority class
+ * @param stats - the statistics are copied here
+ * @return false if there's no such class
+ */
+bool TF_TxGetStats(TinyFrame *tf, uint8_t priority, TF_TxStats *stats);
+
+/**
+ * Clear the statistics of all priority classes
+ *
+ * @param tf - instance
+ */
+void TF_TxResetStats(TinyFrame *tf);
+#endif
+#endif
+
 // ------------------------ MULTIPART FRAME TX FUNCTIONS -----------------------------
 // Those routines are used to send long frames without having all the data available
 // at once (e.g. capturing it from a peripheral or reading from a large memory buffer)
@@ -398,6 +823,162 @@ void TF_Multipart_Payload(TinyFrame *tf, const uint8_t *buff, uint32_t length);
  */
 void TF_Multipart_Close(TinyFrame *tf);
 
+// ------------------------ FRAGMENTED FRAME TX FUNCTIONS -----------------------------
+// A multipart frame holds the Tx lock until it's closed, so nothing else can be sent
+// meanwhile. A fragmented message is sent instead as a series of frames of type
+// TF_FRAG_TYPE with up to TF_FRAG_SIZE bytes each, all with the same frame ID. They go
+// out one at a time from TF_SendNextFragment(), and other frames can be sent in between.
+// The receiver joins them and gives the whole message to the listeners, as if it came
+// in one frame (it must have TF_USE_FRAGMENTS with the same TF_FRAG_TYPE, and
+// TF_FRAG_MAX_LEN large enough).
+
+#if TF_USE_FRAGMENTS
+/**
+ * TF_Send() as a fragmented message. Nothing is sent yet, call TF_SendNextFragment().
+ * The message is copied, but msg.data must stay valid until the last fragment is sent.
+ *
+ * @param tf - instance
+ * @param msg - message to send, up to TF_FRAG_MAX_LEN bytes
+ * @return success (false if TF_MAX_FRAG_TX messages are already being sent)
+ */
+bool TF_Send_Fragmented(TinyFrame *tf, TF_Msg *msg);
+
+/**
+ * TF_Query() as a fragmented message. The listener is added with the first fragment.
+ */
+bool TF_Query_Fragmented(TinyFrame *tf, TF_Msg *msg, TF_Listener listener, TF_Listener_Timeout ftimeout, TF_TICKS timeout);
+
+/**
+ * TF_Respond() as a fragmented message.
+ */
+bool TF_Respond_Fragmented(TinyFrame *tf, TF_Msg *msg);
+
+/**
+ * Send one fragment. Messages being sent take turns. Call it until it returns false,
+ * sending other frames between the calls as needed (or from other threads, with TF_USE_MUTEX).
+ * If the fragment can't be sent (e.g. the TX queue is full), it's tried again on the next call.
+ *
+ * @param tf - instance
+ * @return true if there are fragments left to send
+ */
+bool TF_SendNextFragment(TinyFrame *tf);
+#endif
+
+// ------------------------ RELIABLE DELIVERY -----------------------------
+// With TF_USE_RELIABLE, messages sent by TF_SendReliable() are numbered and kept until
+// the peer acknowledges them. Up to TF_REL_WINDOW of them can be on the way at once.
+// A message not acknowledged within TF_REL_TIMEOUT_TICKS ticks is sent again (call
+// TF_Tick()), only that one. The receiver passes them to the listeners like normal
+// frames, each one once and in the order they were sent. It acks after every
+// TF_REL_ACK_EVERY messages, on the next tick, or at once if one is missing - the ack
+// also lists the messages that came early, so the missing ones are sent again on the
+// next tick, without waiting for the timeout.
+// Both peers need TF_USE_RELIABLE with the same TF_REL_TYPE, TF_REL_WINDOW and TF_REL_MAX_LEN.
+
+#if TF_USE_RELIABLE
+/**
+ * Send a message with reliable delivery. The data is copied.
+ *
+ * The done function is called when the peer has received the message, or with msg.data
+ * NULL if it wasn't received after TF_REL_RETRIES attempts - the peer then skips it.
+ * It gets the message type, data and userdata; the data is valid until the next
+ * TF_SendReliable() call. Its return value is not used.
+ *
+ * With TF_USE_TX_QUEUE, the message and its retransmits go in the class of the message
+ * (msg.priority or its type), acks in the class of TF_REL_TYPE. msg.tx_done isn't used,
+ * the done function is called instead.
+ *
+ * @param tf - instance
+ * @param msg - message to send, up to TF_REL_MAX_LEN bytes. frame_id is set if it was sent now.
+ * @param done - callback, or NULL
+ * @return success (false if TF_REL_WINDOW messages are already waiting for an ack)
+ */
+bool TF_SendReliable(TinyFrame *tf, TF_Msg *msg, TF_Listener done);
+
+/**
+ * Get the nr of reliable messages that can be sent now
+ *
+ * @param tf - instance
+ * @return free slots in the window
+ */
+uint16_t TF_ReliableFree(TinyFrame *tf);
+#endif
+
+// ------------------------ FLOW CONTROL -----------------------------
+// With TF_USE_FLOW_CONTROL, a peer sends only as many frames (and payload bytes) as the
+// other side has room for - the window is TF_FLOW_FRAMES / TF_FLOW_BYTES. The receiver
+// returns credit with frames of type TF_FLOW_TYPE as it handles the received frames
+// (after their listeners return, or in TF_DispatchPending() with TF_USE_RX_QUEUE).
+// Sending fails when there's no credit left - try again later. Frames lost on the way
+// don't use up credit for good: a sender that stays blocked asks the peer for credit
+// every TF_FLOW_PROBE_TICKS ticks (call TF_Tick()).
+// TF_FLOW_QUERIES limits the queries waiting for a response (TF_Query etc.).
+// Not available with TF_USE_MPSC_TX.
+// With TF_USE_RX_QUEUE, grants are applied in the parser thread, with atomic access to
+// the credit limits; probes and returning credit are done by TF_DispatchPending().
+// Sending (and TF_Tick) stays on the side holding the Tx lock.
+
+#if TF_USE_FLOW_CONTROL
+/**
+ * Get the nr of frames that can be sent now
+ *
+ * @param tf - instance
+ * @return nr of frames (payload bytes may run out earlier, with TF_FLOW_BYTES)
+ */
+uint32_t TF_FlowCredit(TinyFrame *tf);
+
+/**
+ * Send the current credit to the peer, e.g. after it restarted.
+ * Normally credit is sent automatically.
+ *
+ * @param tf - instance
+ * @return success
+ */
+bool TF_FlowUpdate(TinyFrame *tf);
+#endif
+
+// ------------------------ LOCK-FREE TX SUBMISSION -----------------------------
+// With TF_USE_MPSC_TX, many threads can send frames without taking the Tx lock:
+// each encodes a frame to its own buffer with TF_EncodeFrame() and passes it to
+// TF_Submit(). One writer thread sends the submitted frames with TF_WriteSubmitted(),
+// in the order they were submitted. Other sending functions can still be used.
+
+#if TF_USE_MPSC_TX
+/**
+ * Encode a whole frame (head, payload and checksum) to a buffer. Thread safe,
+ * doesn't take the Tx lock. A new frame ID is assigned unless msg.is_response is set.
+ * ID listeners are not supported here - use TF_Query() for queries.
+ *
+ * @param tf - instance
+ * @param msg - message to encode, frame_id is set
+ * @param buf - output buffer
+ * @param size - buffer size, at least the payload length + 23 bytes are always enough
+ * @return frame length, 0 if the buffer is too small
+ */
+uint32_t TF_EncodeFrame(TinyFrame *tf, TF_Msg *msg, uint8_t *buf, uint32_t size);
+
+/**
+ * Submit an encoded frame to the writer. Thread safe and lock-free, never waits.
+ * The node and its data must stay untouched until node->done is called.
+ *
+ * @param tf - instance
+ * @param node - the frame (data and len set)
+ */
+void TF_Submit(TinyFrame *tf, TF_TxNode *node);
+
+/**
+ * Send submitted frames with TF_WriteImpl(). Must be called from one thread only.
+ * Takes the Tx lock for each frame, so with TF_USE_MUTEX it waits for TF_Send() etc.
+ * in other threads. If the lock can't be claimed, it stops - the frames left stay
+ * queued for the next call.
+ *
+ * @param tf - instance
+ * @param max - max nr of frames to send, 0 = all that are ready
+ * @return nr of frames sent
+ */
+uint32_t TF_WriteSubmitted(TinyFrame *tf, uint32_t max);
+#endif
+
 
 // ---------------------------------- INTERNAL ----------------------------------
 // This is publicly visible only to allow static init.
@@ -416,21 +997,146 @@ struct TF_IdListener_ {
     TF_ID id;
     TF_Listener fn;
     TF_Listener_Timeout fn_timeout;
-    TF_TICKS timeout;     // nr of ticks remaining to disable this listener
+    TF_TICKS timeout;     // nr of ticks remaining to disable this listener (not counted down with TF_USE_TIMER_WHEEL)
     TF_TICKS timeout_max; // the original timeout is stored here (0 = no timeout)
     void *userdata;
     void *userdata2;
+#if TF_USE_FLOW_CONTROL
+    bool query;           // added by TF_Query() etc., counted in flow_queries
+#endif
+#if TF_USE_TIMER_WHEEL
+    TF_TICKS deadline;    // value of the tick counter at which the listener expires
+    TF_COUNT wheel_next;  // next / previous listener in the wheel bucket (slot number + 1, 0 = none)
+    TF_COUNT wheel_prev;
+    TF_COUNT expire_next; // next listener to expire in TF_Tick() (slot number + 1, 0 = none)
+    uint8_t wheel_state;  // not scheduled, in the wheel, or expiring
+#endif
+#if TF_USE_DYNAMIC_LST
+    TF_COUNT next_free;   // next free slot number + 1 (while this one is free)
+#endif
 };
 
 struct TF_TypeListener_ {
     TF_TYPE type;
     TF_Listener fn;
+#if TF_USE_DYNAMIC_LST
+    TF_COUNT next_free;
+#endif
 };
 
 struct TF_GenericListener_ {
     TF_Listener fn;
+#if TF_USE_DYNAMIC_LST
+    TF_COUNT next_free;
+#endif
 };
 
+#if TF_USE_STREAM_RX
+struct TF_StreamListener_ {
+    TF_TYPE type;
+    TF_StreamListener fn;
+};
+#endif
+
+#if TF_USE_RX_QUEUE
+struct TF_QueuedMsg_ {
+    TF_ID frame_id;
+    TF_TYPE type;
+    TF_LEN len;
+#if TF_USE_RX_POOL
+    uint8_t *data;        //!< Buffer taken over from the parser
+    TF_RxPoolClass *data_class;
+#else
+    uint8_t data[TF_MAX_PAYLOAD_RX];
+#endif
+};
+#endif
+
+#if TF_USE_FRAGMENTS
+/** Fragmented message being sent */
+struct TF_FragTx_ {
+    TF_Msg msg;           //!< The message, frame_id is set by the first fragment
+    TF_LEN sent;          //!< Nr of payload bytes sent
+    TF_Listener listener; //!< ID listener to add with the first fragment
+    TF_Listener_Timeout ftimeout;
+    TF_TICKS timeout;
+    bool used;
+};
+
+/** Fragmented message being received */
+struct TF_FragRx_ {
+    TF_ID id;
+    TF_TYPE type;
+    TF_LEN len;           //!< Total length, from the first fragment
+    TF_LEN received;      //!< Nr of bytes joined so far
+    uint32_t stamp;       //!< When the last fragment came, in frag_stamp counts
+    bool used;
+    uint8_t data[TF_FRAG_MAX_LEN];
+};
+#endif
+
+#if TF_USE_RELIABLE
+/** Reliable message being sent */
+struct TF_RelTx_ {
+    TF_Listener done;     //!< Called when acknowledged or given up on
+    void *userdata;
+    void *userdata2;
+    TF_ID frame_id;       //!< ID of the frame it was last sent in
+    TF_TYPE type;
+    TF_LEN len;
+    TF_TICKS timer;       //!< Ticks until it's sent again
+    uint32_t stamp;       //!< When it was last sent, in rel_tx_stamp counts
+    uint8_t retries;      //!< Nr of times sent again
+    bool acked;
+    bool failed;          //!< Given up on
+#if TF_USE_TX_QUEUE
+    uint8_t priority;     //!< TX queue class, from the original message
+#endif
+    uint8_t data[TF_REL_MAX_LEN];
+};
+
+/** Reliable message received early, before one sent earlier */
+struct TF_RelRx_ {
+    uint16_t seq;
+    TF_ID frame_id;
+    TF_TYPE type;
+    TF_LEN len;
+    bool used;
+    uint8_t data[TF_REL_MAX_LEN];
+};
+#endif
+
+#if TF_USE_TX_QUEUE
+struct TF_TxFrame_ {
+    uint32_t end;         //!< Queue position after the frame
+    TF_ID frame_id;
+    TF_TxCallback cb;     //!< Completion callback or NULL
+    void *userdata;
+#if TF_TX_STATS
+    uint32_t size;        //!< Frame length
+    uint32_t queued;      //!< TF_TxTimestamp() when it was queued
+#endif
+};
+
+/** TX queue of one priority class */
+struct TF_TxClass_ {
+    uint8_t buf[TF_TX_QUEUE_LEN]; //!< Encoded frames waiting for TF_TxDrain()
+    // Positions in the queue - free-running, the index is position modulo TF_TX_QUEUE_LEN
+    uint32_t head;        //!< End of the queued frames, written by the sender
+    uint32_t tail;        //!< End of the sent bytes, written by TF_TxComplete()
+    struct TF_TxFrame_ frames[TF_TX_QUEUE_FRAMES]; //!< Queued frames
+    uint16_t frame_head;  //!< Next slot to fill, written by the sender
+    uint16_t frame_tail;  //!< Oldest frame not sent yet, written by TF_TxComplete()
+#if TF_TX_SCHED == TF_TX_SCHED_WEIGHTED
+    uint16_t weight;      //!< Frames per round
+    uint16_t credit;      //!< Frames left in this round
+#endif
+#if TF_TX_STATS
+    TF_TxStats stats;
+#endif
+};
+#endif
+
 /**
  * Frame parser internal state.
  */
@@ -448,14 +1154,50 @@ struct TinyFrame_ {
     /* Parser state */
     enum TF_State_ state;
     TF_TICKS parser_timeout_ticks;
+#if TF_TICK_MS
+    uint32_t ms_base;       //!< Time of the last tick counted by TF_TickMs()
+    bool ms_started;        //!< ms_base is set
+#endif
+#if TF_USE_TIMER_WHEEL
+    TF_TICKS ticks;         //!< Nr of TF_Tick() calls (wraps around)
+    TF_COUNT wheel[TF_TIMER_WHEEL_SIZE]; //!< ID listeners by deadline modulo wheel size (slot number + 1, 0 = none)
+#endif
     TF_ID id;               //!< Incoming packet ID
     TF_LEN len;             //!< Payload length
+#if TF_USE_RX_QUEUE
+    struct TF_QueuedMsg_ rxq[TF_RX_QUEUE_LEN]; //!< Received messages waiting for TF_DispatchPending()
+    uint16_t rxq_head;      //!< Next slot to fill, written by the parser
+    uint16_t rxq_tail;      //!< Next slot to dispatch, written by TF_DispatchPending()
+    uint32_t rxq_dropped;   //!< Nr of messages dropped because the queue was full
+#endif
+#if TF_USE_RX_POOL
+    TF_RxPool *rx_pool;     //!< Pool to take RX buffers from
+    TF_RxPoolClass *data_class; //!< Class of the current RX buffer, NULL if none is held
+    uint8_t *data;          //!< Data byte buffer, taken from rx_pool
+#else
     uint8_t data[TF_MAX_PAYLOAD_RX]; //!< Data byte buffer
+#endif
+#if TF_USE_ZEROCOPY_RX
+    const uint8_t *data_ext; //!< Payload found in place in the TF_Accept() buffer, or NULL
+#endif
     TF_LEN rxi;             //!< Field size byte counter
     TF_CKSUM cksum;         //!< Checksum calculated of the data stream
     TF_CKSUM ref_cksum;     //!< Reference checksum read from the message
     TF_TYPE type;           //!< Collected message type number
     bool discard_data;      //!< Set if (len > TF_MAX_PAYLOAD) to read the frame, but ignore the data.
+#if TF_USE_STREAM_RX
+    TF_StreamListener stream_fn; //!< Listener receiving the current frame in pieces, or NULL
+    TF_LEN stream_pos;      //!< Payload offset of data[0] in a streamed frame
+#endif
+#if TF_USE_COBS
+    uint8_t cobs_left;      //!< Bytes left in the group being decoded, 0 = a code comes next
+    bool cobs_zero;         //!< The group ends with a zero (if another group follows)
+    bool cobs_sync;         //!< A delimiter came, the next byte starts a frame
+#endif
+#if TF_USE_RESYNC
+    uint8_t head_buf[1 + TF_ID_BYTES + TF_LEN_FIELD_MAX + TF_TYPE_FIELD_MAX + sizeof(TF_CKSUM)]; //!< Header bytes received so far
+    uint8_t head_len;       //!< Nr of bytes in head_buf
+#endif
 
     /* Tx state */
     // Buffer for building frames
@@ -465,6 +1207,25 @@ struct TinyFrame_ {
     uint32_t tx_len;        //!< Total expected Tx length
     TF_CKSUM tx_cksum;      //!< Transmit checksum accumulator
 
+#if TF_USE_COBS
+    // Encoded frame bytes, sent when full. The code of an open group is only known when it ends.
+    uint8_t cobs_buf[TF_COBS_BUF_LEN];
+    uint32_t cobs_code;     //!< Position of the open group's code
+    uint32_t cobs_pos;      //!< Next write position
+#endif
+
+#if TF_USE_TX_QUEUE
+    struct TF_TxClass_ txq[TF_TX_PRIORITIES]; //!< TX queues by priority class
+    uint8_t txq_cur;        //!< Class being sent by TF_TxDrain()
+    uint32_t txq_cur_end;   //!< Where TF_TxDrain() stops in it (end of a frame)
+    uint8_t txq_prio;       //!< Class of the frame being composed
+    uint32_t txq_write;     //!< Write position in the frame being composed
+    uint32_t txq_limit;     //!< End of the space reserved for its payload
+    TF_TxCallback tx_done;  //!< Completion callback of the frame being composed
+    void *tx_done_data;     //!< Its userdata
+    TF_ID tx_done_id;       //!< Its frame ID
+#endif
+
 #if !TF_USE_MUTEX
     bool soft_lock;         //!< Tx lock flag used if the mutex feature is not enabled.
 #endif
@@ -472,9 +1233,19 @@ struct TinyFrame_ {
     /* --- Callbacks --- */
 
     /* Transaction callbacks */
+#if TF_USE_DYNAMIC_LST
+    // Tables allocated with TF_Alloc(), growing up to TF_MAX_*_LST
+    struct TF_IdListener_ *id_listeners;
+    struct TF_TypeListener_ *type_listeners;
+    struct TF_GenericListener_ *generic_listeners;
+#else
     struct TF_IdListener_ id_listeners[TF_MAX_ID_LST];
     struct TF_TypeListener_ type_listeners[TF_MAX_TYPE_LST];
     struct TF_GenericListener_ generic_listeners[TF_MAX_GEN_LST];
+#endif
+#if TF_USE_STREAM_RX
+    struct TF_StreamListener_ stream_listeners[TF_MAX_STREAM_LST];
+#endif
 
     // Those counters are used to optimize look-up times.
     // They point to the highest used slot number,
@@ -482,6 +1253,102 @@ struct TinyFrame_ {
     TF_COUNT count_id_lst;
     TF_COUNT count_type_lst;
     TF_COUNT count_generic_lst;
+#if TF_USE_STREAM_RX
+    TF_COUNT count_stream_lst;
+#endif
+
+#if TF_USE_DYNAMIC_LST
+    // Table sizes
+    TF_COUNT cap_id_lst;
+    TF_COUNT cap_type_lst;
+    TF_COUNT cap_generic_lst;
+    // Free slot lists, linked through next_free (slot number + 1, 0 = none)
+    TF_COUNT free_id_lst;
+    TF_COUNT free_type_lst;
+    TF_COUNT free_generic_lst;
+#endif
+
+#if TF_USE_ID_HASH
+    // Index of ID listeners by frame ID (open addressing, linear probing).
+    // Entries are slot numbers + 1, 0 = empty.
+  #if TF_USE_DYNAMIC_LST
+    TF_COUNT *id_hash;      //!< At least twice as large as id_listeners, a power of two
+    uint32_t id_hash_mask;  //!< Index size - 1
+  #else
+    TF_COUNT id_hash[TF_ID_HASH_SIZE];
+  #endif
+#endif
+
+#if TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_SORTED
+    // Type listeners sorted by type and slot number
+  #if TF_USE_DYNAMIC_LST
+    struct TF_TypeIndex_ {
+        TF_TYPE type;
+        TF_COUNT slot;
+    } *type_sorted;
+    TF_COUNT cap_type_sorted;
+  #else
+    struct TF_TypeIndex_ {
+        TF_TYPE type;
+        TF_COUNT slot;
+    } type_sorted[TF_MAX_TYPE_LST];
+  #endif
+    TF_COUNT count_type_sorted;
+#elif TF_TYPE_DISPATCH == TF_TYPE_DISPATCH_DIRECT
+    // Lowest slot number + 1 of a Type listener for each type, 0 = none
+    TF_COUNT type_direct[256];
+#endif
+
+#if TF_USE_FLOW_CONTROL
+    // Counters are totals since init, compared with wrap-around
+    // Written by the sending side (under the Tx lock), read atomically by the parser thread
+    uint32_t flow_tx_frames;      //!< Frames sent
+    uint32_t flow_tx_bytes;       //!< Payload bytes sent
+    // Written atomically by the parser thread when a grant comes, read by the sending side
+    uint32_t flow_limit_frames;   //!< Frames that may be sent, granted by the peer
+    uint32_t flow_limit_bytes;    //!< Payload bytes that may be sent
+    bool flow_blocked;            //!< A frame was refused for lack of credit (set by the sending side)
+    // Sending side only (and TF_Tick)
+    TF_TICKS flow_probe_ticks;    //!< Ticks since blocked or the last probe
+    // Owned by the thread running the listeners (TF_DispatchPending() with TF_USE_RX_QUEUE)
+    uint32_t flow_rx_frames;      //!< Received frames handled
+    uint32_t flow_rx_bytes;       //!< Their payload bytes
+    uint32_t flow_granted_frames; //!< Limits last granted to the peer
+    uint32_t flow_granted_bytes;
+    TF_COUNT flow_queries;        //!< Queries waiting for a response, kept with the ID listeners
+#endif
+
+#if TF_USE_RELIABLE
+    // Sequence nrs wrap around, slots are taken by sequence nr modulo TF_REL_WINDOW
+    struct TF_RelTx_ rel_tx[TF_REL_WINDOW];
+    uint16_t rel_tx_base;   //!< Oldest message not released yet
+    uint16_t rel_tx_next;   //!< Sequence nr of the next new message
+    uint32_t rel_tx_stamp;  //!< Nr of reliable frames sent
+    struct TF_RelRx_ rel_rx[TF_REL_WINDOW];
+    uint16_t rel_rx_next;   //!< Next sequence nr to pass to the listeners
+    TF_COUNT rel_rx_unacked; //!< Messages received since the last ack
+    bool rel_ack_due;       //!< An ack is to be sent on the next tick
+#endif
+
+#if TF_USE_COMPRESSION
+    uint16_t comp_hash[1 << TF_COMP_HASH_BITS]; //!< Positions of recent 3-byte sequences + 1, used by the compressor
+    uint8_t comp_tx[TF_COMP_MAX_LEN];           //!< Compressed message being sent
+    uint8_t comp_rx[TF_COMP_MAX_LEN];           //!< Decompressed received message
+#endif
+
+#if TF_USE_MPSC_TX
+    // Submitted frames, an intrusive MPSC queue: producers swap in the head, the writer takes from the tail
+    TF_TxNode *mpsc_head;   //!< Last submitted node
+    TF_TxNode *mpsc_tail;   //!< Next node to write (or the stub), only used by the writer
+    TF_TxNode mpsc_stub;    //!< Placeholder keeping the queue non-empty
+#endif
+
+#if TF_USE_FRAGMENTS
+    struct TF_FragTx_ frag_tx[TF_MAX_FRAG_TX];
+    TF_COUNT frag_tx_next;  //!< Message to send a fragment of next
+    struct TF_FragRx_ frag_rx[TF_MAX_FRAG_RX];
+    uint32_t frag_stamp;    //!< Nr of fragments received
+#endif
 };
 
 
@@ -494,6 +1361,33 @@ struct TinyFrame_ {
  */
 extern void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len);
 
+#if TF_USE_WRITEV
+
+    /**
+     * Vectored 'write bytes' function, used instead of TF_WriteImpl() if TF_USE_WRITEV is 1.
+     * The pieces must be sent in order, e.g. with one writev() call.
+     *
+     * The frame head and checksum are in the send buffer, the payload is passed
+     * in place from the buffer given to TF_Send() etc. It's valid only during the call.
+     *
+     * @param tf - instance
+     * @param iov - pieces of the frame
+     * @param count - nr of pieces (1 to 3)
+     */
+    extern void TF_WriteImplV(TinyFrame *tf, const TF_IoVec *iov, uint8_t count);
+
+#endif
+
+#if TF_USE_TX_QUEUE && TF_TX_STATS
+
+    /**
+     * Time source for the TX queueing delay statistics, e.g. a microsecond
+     * counter. Any unit, it may wrap around.
+     */
+    extern uint32_t TF_TxTimestamp(TinyFrame *tf);
+
+#endif
+
 // Mutex functions
 #if TF_USE_MUTEX
 
@@ -505,6 +1399,17 @@ extern void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len);
 
 #endif
 
+// Allocator for listener tables
+#if TF_USE_DYNAMIC_LST
+
+    /** Allocate memory for a listener table, return NULL if there's not enough */
+    extern void *TF_Alloc(TinyFrame *tf, uint32_t size);
+
+    /** Free memory from TF_Alloc() */
+    extern void TF_Free(TinyFrame *tf, void *ptr);
+
+#endif
+
 // Custom checksum functions
 #if (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM8) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM16) || (TF_CKSUM_TYPE == TF_CKSUM_CUSTOM32)
 
@@ -532,6 +1437,19 @@ extern void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len);
      */
     extern TF_CKSUM TF_CksumEnd(TF_CKSUM cksum);
 
+    #if TF_CKSUM_CUSTOM_BLOCK
+        /**
+         * Update a checksum with a block of bytes (used if TF_CKSUM_CUSTOM_BLOCK is 1).
+         * Must give the same result as calling TF_CksumAdd() for each byte.
+         *
+         * @param cksum - previous checksum value
+         * @param data - bytes to add
+         * @param len - number of bytes
+         * @return updated checksum value
+         */
+        extern TF_CKSUM TF_CksumAddBlock(TF_CKSUM cksum, const uint8_t *data, uint32_t len);
+    #endif
+
 #endif
 
 #endif
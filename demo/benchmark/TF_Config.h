@@ -0,0 +1,99 @@
+//
+// Config for the benchmarks. Options compared by a benchmark can be given
+// on the command line, see the Makefile.
+//
+
+#ifndef TF_CONFIG_H
+#define TF_CONFIG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef TF_ID_BYTES
+#define TF_ID_BYTES     1
+#endif
+#ifndef TF_LEN_BYTES
+#define TF_LEN_BYTES    2
+#endif
+#define TF_TYPE_BYTES   1
+#ifndef TF_CKSUM_TYPE
+#define TF_CKSUM_TYPE TF_CKSUM_CRC16
+#endif
+#ifndef TF_CKSUM_SLICING
+#define TF_CKSUM_SLICING 1
+#endif
+#ifndef TF_CKSUM_HW
+#define TF_CKSUM_HW     0
+#endif
+#ifndef TF_USE_SOF_BYTE
+#define TF_USE_SOF_BYTE 1
+#endif
+#define TF_SOF_BYTE     0x01
+#ifndef TF_USE_RESYNC
+#define TF_USE_RESYNC   0
+#endif
+#ifndef TF_USE_COBS
+#define TF_USE_COBS     0
+#endif
+#ifndef TF_USE_VARINT
+#define TF_USE_VARINT   0
+#endif
+typedef uint16_t TF_TICKS;
+typedef uint16_t TF_COUNT;
+#ifndef TF_MAX_PAYLOAD_RX
+#define TF_MAX_PAYLOAD_RX 1024
+#endif
+#define TF_SENDBUF_LEN 64
+#ifndef TF_MAX_ID_LST
+#define TF_MAX_ID_LST   10
+#endif
+#ifndef TF_USE_ID_HASH
+#define TF_USE_ID_HASH  0
+#endif
+#define TF_ID_HASH_SIZE 2048
+#ifndef TF_USE_TIMER_WHEEL
+#define TF_USE_TIMER_WHEEL 0
+#endif
+#define TF_TIMER_WHEEL_SIZE 1024
+#ifndef TF_MAX_TYPE_LST
+#define TF_MAX_TYPE_LST 10
+#endif
+#define TF_MAX_GEN_LST  5
+#ifndef TF_USE_FRAGMENTS
+#define TF_USE_FRAGMENTS 0
+#endif
+#define TF_FRAG_TYPE     0xFF
+#define TF_FRAG_SIZE     1000
+#define TF_FRAG_MAX_LEN  (1024 * 1024)
+#define TF_MAX_FRAG_TX   1
+#define TF_MAX_FRAG_RX   1
+#ifndef TF_USE_RELIABLE
+#define TF_USE_RELIABLE 0
+#endif
+#define TF_REL_TYPE      0xFD
+#ifndef TF_REL_WINDOW
+#define TF_REL_WINDOW    32
+#endif
+#define TF_REL_MAX_LEN   64
+#define TF_REL_TIMEOUT_TICKS 30
+#define TF_REL_RETRIES   50
+#define TF_REL_ACK_EVERY 4
+#ifndef TF_USE_COMPRESSION
+#define TF_USE_COMPRESSION 0
+#endif
+#define TF_COMP_TYPE      0xFC
+#define TF_COMP_THRESHOLD 32
+#define TF_COMP_MAX_LEN   1024
+#define TF_COMP_HASH_BITS 10
+#define TF_PARSER_TIMEOUT_TICKS 10
+#ifndef TF_USE_MUTEX
+#define TF_USE_MUTEX  0
+#endif
+#ifndef TF_USE_MPSC_TX
+#define TF_USE_MPSC_TX 0
+#endif
+
+// errors are expected, don't print them
+#define TF_Error(format, ...)
+
+#endif //TF_CONFIG_H
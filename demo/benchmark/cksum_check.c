@@ -0,0 +1,171 @@
+//
+// Checks the block checksum (slicing-by-N, CPU CRC instructions) against a
+// plain bit-by-bit CRC, for every payload length 0-4000 at every offset 0-15
+// in a 16-byte aligned buffer. Build it for each TF_CKSUM_TYPE, TF_CKSUM_SLICING
+// and TF_CKSUM_HW, see the Makefile.
+//
+// Usage: cksum_*.bin
+//
+// Exits with 1 on the first mismatch.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+
+#define MAX_LEN 4000
+#define OFFSETS 16
+
+static uint8_t wire[MAX_LEN + 64];
+static uint32_t wire_len;
+static const uint8_t *expected;
+static uint32_t expected_len;
+static uint32_t received;
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+static TF_Result checkListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    if (msg->len == expected_len && (msg->len == 0 || memcmp(msg->data, expected, msg->len) == 0)) {
+        received++;
+    }
+    return TF_STAY;
+}
+
+/** One byte of the reference checksum, a bit at a time */
+static uint32_t ref_add(uint32_t cksum, uint8_t byte)
+{
+    int bit;
+
+#if TF_CKSUM_TYPE == TF_CKSUM_XOR
+    return cksum ^ byte;
+#else
+    #if TF_CKSUM_TYPE == TF_CKSUM_CRC8
+        const uint32_t poly = 0x8C; // 0x31 reflected
+    #elif TF_CKSUM_TYPE == TF_CKSUM_CRC16
+        const uint32_t poly = 0xA001; // 0x8005 reflected
+    #elif TF_CKSUM_TYPE == TF_CKSUM_CRC32
+        const uint32_t poly = 0xEDB88320;
+    #elif TF_CKSUM_TYPE == TF_CKSUM_CRC32C
+        const uint32_t poly = 0x82F63B78;
+    #else
+        #error "No reference for this TF_CKSUM_TYPE"
+    #endif
+    cksum ^= byte;
+    for (bit = 0; bit < 8; bit++) {
+        cksum = (cksum & 1) ? (cksum >> 1) ^ poly : cksum >> 1;
+    }
+    return cksum;
+#endif
+}
+
+#if TF_CKSUM_TYPE == TF_CKSUM_CRC32 || TF_CKSUM_TYPE == TF_CKSUM_CRC32C
+    #define REF_START 0xFFFFFFFF
+    #define REF_END(c) ((TF_CKSUM) ~(c))
+#elif TF_CKSUM_TYPE == TF_CKSUM_XOR
+    #define REF_START 0
+    #define REF_END(c) ((TF_CKSUM) ~(c))
+#else
+    #define REF_START 0
+    #define REF_END(c) ((TF_CKSUM) (c))
+#endif
+
+/** The data checksum at the end of the frame on the wire */
+static TF_CKSUM wire_cksum(void)
+{
+    TF_CKSUM cksum = 0;
+    uint32_t i;
+
+    for (i = wire_len - sizeof(TF_CKSUM); i < wire_len; i++) {
+        cksum = (TF_CKSUM) ((cksum << 8) | wire[i]);
+    }
+    return cksum;
+}
+
+static int fail(const char *what, uint32_t len, uint32_t offset, uint32_t got, uint32_t want)
+{
+    printf("TF_CKSUM_TYPE=%d, TF_CKSUM_SLICING=%d, TF_CKSUM_HW=%d: FAIL!!!! %s, len %d offset %d: %08x, expected %08x\n",
+           TF_CKSUM_TYPE, TF_CKSUM_SLICING, TF_CKSUM_HW, what, (int)len, (int)offset, (unsigned)got, (unsigned)want);
+    return 1;
+}
+
+int main(void)
+{
+    static uint8_t payload[MAX_LEN];
+    static uint8_t buf[OFFSETS + sizeof(wire)] __attribute__((aligned(16)));
+    static TF_CKSUM ref[MAX_LEN + 1]; // reference checksum of each payload prefix
+    uint32_t cksum, len, offset, seed = 1;
+    TinyFrame *tx, *rx;
+    TF_Msg msg;
+
+    for (len = 0; len < MAX_LEN; len++) {
+        seed = seed * 1103515245 + 12345;
+        payload[len] = (uint8_t) (seed >> 16);
+    }
+
+    cksum = REF_START;
+    ref[0] = REF_END(cksum);
+    for (len = 0; len < MAX_LEN; len++) {
+        cksum = ref_add(cksum, payload[len]);
+        ref[len + 1] = REF_END(cksum);
+    }
+
+    tx = TF_Init(TF_MASTER);
+    rx = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(rx, checkListener);
+
+    // the standard check values, so the reference isn't wrong the same way
+    wire_len = 0;
+    TF_SendSimple(tx, 0x10, (const uint8_t *) "123456789", 9);
+#if TF_CKSUM_TYPE == TF_CKSUM_CRC8
+    if (wire_cksum() != 0xA1) return fail("check value", 9, 0, wire_cksum(), 0xA1);
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC16
+    if (wire_cksum() != 0xBB3D) return fail("check value", 9, 0, wire_cksum(), 0xBB3D);
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC32
+    if (wire_cksum() != 0xCBF43926) return fail("check value", 9, 0, wire_cksum(), 0xCBF43926);
+#elif TF_CKSUM_TYPE == TF_CKSUM_CRC32C
+    if (wire_cksum() != 0xE3069283) return fail("check value", 9, 0, wire_cksum(), 0xE3069283);
+#elif TF_CKSUM_TYPE == TF_CKSUM_XOR
+    if (wire_cksum() != (TF_CKSUM) ~0x31) return fail("check value", 9, 0, wire_cksum(), (TF_CKSUM) ~0x31);
+#endif
+
+    for (offset = 0; offset < OFFSETS; offset++) {
+        for (len = 0; len <= MAX_LEN; len++) {
+            // sending checksums the payload in TF_SENDBUF_LEN chunks
+            TF_ClearMsg(&msg);
+            msg.type = 0x10;
+            msg.data = payload;
+            msg.len = (TF_LEN) len;
+            wire_len = 0;
+            TF_Send(tx, &msg);
+            if (len > 0 && wire_cksum() != ref[len]) {
+                return fail("sent", len, offset, wire_cksum(), ref[len]);
+            }
+
+            // receiving checksums all but the last payload byte as one block, starting
+            // at 'offset' + the head length
+            memcpy(buf + offset, wire, wire_len);
+            expected = payload;
+            expected_len = len;
+            received = 0;
+            TF_Accept(rx, buf + offset, wire_len);
+            if (received != 1) {
+                return fail("received", len, offset, received, 1);
+            }
+        }
+    }
+
+    printf("TF_CKSUM_TYPE=%d, TF_CKSUM_SLICING=%d, TF_CKSUM_HW=%d: OK\n",
+           TF_CKSUM_TYPE, TF_CKSUM_SLICING, TF_CKSUM_HW);
+
+    TF_DeInit(tx);
+    TF_DeInit(rx);
+    return 0;
+}
@@ -0,0 +1,125 @@
+//
+// Bytes on the wire and CPU time per frame for telemetry payloads, sent raw
+// (TF_USE_COMPRESSION=0) or compressed.
+//
+// Usage: comp_*.bin [frames]
+//
+// Each payload is a JSON report of 8 channels with slowly changing values,
+// about 250 bytes.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../TinyFrame.h"
+
+#define BAUD 115200
+#define CHANNELS 8
+
+static uint8_t *wire;
+static uint32_t wire_len;
+static uint32_t wire_size;
+static uint32_t received;
+static uint32_t received_ok = 1;
+static char expected[1024];
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    if (wire_len + len > wire_size) {
+        wire_size = (wire_len + len) * 2;
+        wire = realloc(wire, wire_size);
+    }
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+static TF_Result checkListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    if (msg->type != 0x30 || msg->len != strlen(expected) || memcmp(msg->data, expected, msg->len) != 0) {
+        received_ok = 0;
+    }
+    received++;
+    return TF_STAY;
+}
+
+/** Telemetry report nr. n */
+static uint32_t report(uint32_t n, char *buf)
+{
+    uint32_t len;
+    int c;
+
+    len = (uint32_t) sprintf(buf, "{\"seq\":%u,\"ch\":[", (unsigned) n);
+    for (c = 0; c < CHANNELS; c++) {
+        len += (uint32_t) sprintf(buf + len, "%s{\"id\":%d,\"mv\":%u,\"st\":\"ok\"}",
+                                  c ? "," : "", c, (unsigned) (3300 + (n * (c + 1) / 16) % 50));
+    }
+    len += (uint32_t) sprintf(buf + len, "]}");
+    return len;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 100000;
+    uint64_t payload_bytes = 0;
+    char buf[1024];
+    uint32_t *ends; // where each frame ends on the wire
+    uint32_t i, len;
+    TinyFrame *tx, *rx;
+    double t0, t_send, t_recv;
+
+    if (argc > 1) frames = (uint32_t) atoi(argv[1]);
+    ends = malloc(frames * sizeof(uint32_t));
+
+    tx = TF_Init(TF_MASTER);
+    rx = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(rx, checkListener);
+
+    // send all, then receive one by one to check them
+    t0 = now();
+    for (i = 0; i < frames; i++) {
+        len = report(i, buf);
+        payload_bytes += len;
+        TF_SendSimple(tx, 0x30, (const uint8_t *) buf, (TF_LEN) len);
+        ends[i] = wire_len;
+    }
+    t_send = now() - t0;
+
+    // the time to make the reports, to subtract
+    t0 = now();
+    for (i = 0; i < frames; i++) {
+        report(i, buf);
+    }
+    t_send -= now() - t0;
+
+    t_recv = 0;
+    for (i = 0; i < frames; i++) {
+        report(i, expected);
+        t0 = now();
+        TF_Accept(rx, wire + (i ? ends[i - 1] : 0), ends[i] - (i ? ends[i - 1] : 0));
+        t_recv += now() - t0;
+    }
+
+    printf("TF_USE_COMPRESSION=%d, %d frames, %s\n", TF_USE_COMPRESSION, (int)frames,
+           received == frames && received_ok ? "OK" : "FAIL!!!!");
+    printf("  payload bytes  %.1f per frame\n", (double)payload_bytes / frames);
+    printf("  wire bytes     %.1f per frame (%.1f %%)\n", (double)wire_len / frames, 100.0 * wire_len / payload_bytes);
+    printf("  frames/s       %.0f at %d baud\n", BAUD / 10.0 / ((double)wire_len / frames), BAUD);
+    printf("  send           %.0f ns/frame\n", t_send * 1e9 / frames);
+    printf("  receive        %.0f ns/frame\n", t_recv * 1e9 / frames);
+
+    TF_DeInit(tx);
+    TF_DeInit(rx);
+    free(wire);
+    free(ends);
+    return 0;
+}
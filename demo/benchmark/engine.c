@@ -0,0 +1,161 @@
+//
+// Aggregate RX throughput of TfEngine with 1, 2, 4, ... worker threads.
+//
+// Usage: engine.bin [max workers] [links]
+//
+// Every link receives the same stream of frames. There are as many feeder
+// threads as workers, each feeding its share of the links (a link is always
+// fed by one thread), like socket reader threads would.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../../TinyFrame.h"
+#include "../../utilities/tf_engine.h"
+
+#define FRAMES_PER_LINK 500
+#define PAYLOAD_LEN 64
+#define FEED_CHUNK 256
+
+static uint8_t *stream;
+static uint32_t stream_len;
+
+static TfEngine *engine;
+static uint32_t link_count;
+static uint32_t feeder_count;
+static uint32_t *received; // per link, written only by the link's worker
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    stream = realloc(stream, stream_len + len);
+    memcpy(stream + stream_len, buff, len);
+    stream_len += len;
+}
+
+static TF_Result countListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)msg;
+    received[tf->usertag]++;
+    return TF_STAY;
+}
+
+/** Feed the stream to links (index % feeder_count == nr), a chunk to each in turn */
+static void *feeder(void *arg)
+{
+    uint32_t nr = (uint32_t) (size_t) arg;
+    uint32_t mine = (link_count - nr + feeder_count - 1) / feeder_count;
+    uint32_t *pos = calloc(mine, sizeof(uint32_t));
+    uint32_t done = 0;
+    uint32_t i, link, n;
+
+    while (done < mine) {
+        for (i = 0; i < mine; i++) {
+            if (pos[i] == stream_len) continue;
+
+            link = nr + i * feeder_count;
+            n = stream_len - pos[i];
+            if (n > FEED_CHUNK) n = FEED_CHUNK;
+
+            pos[i] += tfe_feed(engine, link, stream + pos[i], n);
+            if (pos[i] == stream_len) done++;
+        }
+    }
+
+    free(pos);
+    return NULL;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t max_workers = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+    uint8_t payload[PAYLOAD_LEN];
+    TinyFrame **links;
+    TinyFrame *tx;
+    TfEngineConfig cfg;
+    pthread_t *feeders;
+    uint32_t workers, i, total;
+    double t0, t1, base_rate = 0;
+
+    link_count = 1024;
+    if (argc > 1) max_workers = (uint32_t) atoi(argv[1]);
+    if (argc > 2) link_count = (uint32_t) atoi(argv[2]);
+
+    memset(payload, 0x55, sizeof(payload));
+    tx = TF_Init(TF_MASTER);
+    for (i = 0; i < FRAMES_PER_LINK; i++) {
+        TF_SendSimple(tx, 0x22, payload, PAYLOAD_LEN);
+    }
+    TF_DeInit(tx);
+
+    links = malloc(sizeof(TinyFrame *) * link_count);
+    received = malloc(sizeof(uint32_t) * link_count);
+    feeders = malloc(sizeof(pthread_t) * max_workers);
+    for (i = 0; i < link_count; i++) {
+        links[i] = TF_Init(TF_SLAVE);
+        links[i]->usertag = i;
+        TF_AddGenericListener(links[i], countListener);
+    }
+
+    printf("%d links, %d frames of %d bytes per link, %ld CPUs\n",
+           (int)link_count, FRAMES_PER_LINK, PAYLOAD_LEN, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %14s %8s\n", "workers", "frames/s", "speedup");
+
+    for (workers = 1; workers <= max_workers; workers *= 2) {
+        memset(received, 0, sizeof(uint32_t) * link_count);
+
+        cfg.worker_count = workers;
+        cfg.ring_size = 4096;
+        cfg.tick_us = 10000;
+        cfg.pin_workers = true;
+        engine = tfe_create(links, link_count, &cfg);
+        if (engine == NULL) {
+            fprintf(stderr, "tfe_create failed\n");
+            return 1;
+        }
+
+        feeder_count = workers;
+        t0 = now();
+        tfe_start(engine);
+        for (i = 0; i < feeder_count; i++) {
+            pthread_create(&feeders[i], NULL, feeder, (void *) (size_t) i);
+        }
+        for (i = 0; i < feeder_count; i++) {
+            pthread_join(feeders[i], NULL);
+        }
+        tfe_stop(engine); // returns when everything fed is processed
+        t1 = now();
+        tfe_destroy(engine);
+
+        total = 0;
+        for (i = 0; i < link_count; i++) {
+            total += received[i];
+        }
+        if (total != link_count * FRAMES_PER_LINK) {
+            printf("lost %d frames!\n", (int)(link_count * FRAMES_PER_LINK - total));
+        }
+
+        if (workers == 1) base_rate = total / (t1 - t0);
+        printf("%8d %14.0f %7.2fx\n", (int)workers, total / (t1 - t0), total / (t1 - t0) / base_rate);
+    }
+
+    for (i = 0; i < link_count; i++) {
+        TF_DeInit(links[i]);
+    }
+    free(links);
+    free(received);
+    free(feeders);
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,138 @@
+//
+// Latency of short frames sent during a long transfer, with the transfer
+// sent as one multipart frame (TF_USE_FRAGMENTS=0) or fragmented.
+//
+// A 1 MB payload is sent while a short control frame is requested every
+// PING_EVERY bytes on the wire. The latency of a control frame is the nr of
+// bytes that went on the wire from the request until the end of the frame.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../TinyFrame.h"
+
+#define TOTAL (1024 * 1024)
+#define CHUNK 1000
+#define PING_EVERY 4096
+#define BAUD 115200
+
+static uint8_t *payload;
+
+static uint8_t *wire;
+static uint32_t wire_len;
+static uint32_t wire_size;
+
+static bool ping_pending;
+static uint32_t ping_time;
+static uint32_t next_ping = PING_EVERY;
+static uint32_t ping_count;
+static uint32_t ping_max;
+static uint64_t ping_sum;
+
+static bool received_ok;
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    if (wire_len + len > wire_size) {
+        wire_size = (wire_len + len) * 2;
+        wire = realloc(wire, wire_size);
+    }
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+/** Request a control frame when it's time, and send it if the link is free */
+static void ping(TinyFrame *tf)
+{
+    uint32_t latency;
+
+    // the request came while the byte at next_ping was being sent
+    if (!ping_pending && wire_len >= next_ping) {
+        ping_pending = true;
+        ping_time = next_ping;
+        next_ping += PING_EVERY;
+    }
+
+    if (ping_pending && TF_SendSimple(tf, 0x10, (const uint8_t *) "ping", 4)) {
+        latency = wire_len - ping_time;
+        if (latency > ping_max) ping_max = latency;
+        ping_sum += latency;
+        ping_count++;
+        ping_pending = false;
+    }
+}
+
+#if TF_USE_FRAGMENTS
+/** Check the reassembled payload */
+static TF_Result checkListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    if (msg->type != 0x22) return TF_STAY;
+    received_ok = (msg->len == TOTAL && memcmp(msg->data, payload, TOTAL) == 0);
+    return TF_STAY;
+}
+#endif
+
+int main(void)
+{
+    TinyFrame *tx;
+    TF_Msg msg;
+    clock_t start;
+    double seconds;
+    uint32_t i;
+
+    payload = malloc(TOTAL);
+    for (i = 0; i < TOTAL; i++) {
+        payload[i] = (uint8_t) (i * 7 + (i >> 8));
+    }
+
+    tx = TF_Init(TF_MASTER);
+    TF_ClearMsg(&msg);
+    msg.type = 0x22;
+    msg.len = TOTAL;
+
+    start = clock();
+#if TF_USE_FRAGMENTS
+    msg.data = payload;
+    TF_Send_Fragmented(tx, &msg);
+    while (TF_SendNextFragment(tx)) {
+        ping(tx);
+    }
+#else
+    TF_Send_Multipart(tx, &msg);
+    for (i = 0; i < TOTAL; i += CHUNK) {
+        TF_Multipart_Payload(tx, payload + i, TOTAL - i < CHUNK ? TOTAL - i : CHUNK);
+        ping(tx); // fails, the multipart frame holds the Tx lock
+    }
+    TF_Multipart_Close(tx);
+#endif
+    ping(tx);
+    seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+#if TF_USE_FRAGMENTS
+    {
+        TinyFrame *rx = TF_Init(TF_SLAVE);
+        TF_AddGenericListener(rx, checkListener);
+        TF_Accept(rx, wire, wire_len);
+        TF_DeInit(rx);
+    }
+#else
+    received_ok = true; // not checked, one frame larger than TF_MAX_PAYLOAD_RX
+#endif
+
+    printf("TF_USE_FRAGMENTS=%d, %d byte payload, %s\n", TF_USE_FRAGMENTS, TOTAL, received_ok ? "OK" : "FAIL!!!!");
+    printf("  wire bytes     %d (+%.2f %%)\n", (int)wire_len, 100.0 * (wire_len - TOTAL) / TOTAL);
+    printf("  send time      %.2f ms\n", seconds * 1000);
+    printf("  control frames %d\n", (int)ping_count);
+    printf("  latency max    %d bytes = %.1f ms at %d baud\n", (int)ping_max, ping_max * 10000.0 / BAUD, BAUD);
+    printf("  latency avg    %d bytes = %.1f ms at %d baud\n", (int)(ping_count ? ping_sum / ping_count : 0),
+           (ping_count ? (double)ping_sum / ping_count : 0) * 10000.0 / BAUD, BAUD);
+
+    TF_DeInit(tx);
+    free(payload);
+    free(wire);
+    return 0;
+}
@@ -0,0 +1,105 @@
+//
+// Bytes on the wire and receive time per frame with fixed-width LEN and TYPE
+// fields (TF_USE_VARINT=0) or varints, with TF_LEN_BYTES 4.
+//
+// Usage: head_*.bin [frames]
+//
+// The traffic is sensor readings of 4-16 bytes, with a 1000 byte block
+// every 64 frames - the reason for TF_LEN_BYTES 4.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../TinyFrame.h"
+
+#define BAUD 115200
+
+static uint8_t *wire;
+static uint32_t wire_len;
+static uint32_t wire_size;
+static uint32_t received;
+static uint32_t received_ok = 1;
+static uint32_t expected_len;
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    if (wire_len + len > wire_size) {
+        wire_size = (wire_len + len) * 2;
+        wire = realloc(wire, wire_size);
+    }
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+static TF_Result checkListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    if (msg->len != expected_len || msg->type != 0x10 + (expected_len & 0x0F)) {
+        received_ok = 0;
+    }
+    received++;
+    return TF_STAY;
+}
+
+/** Payload length of frame nr. n */
+static uint32_t frame_len(uint32_t n)
+{
+    return (n % 64 == 63) ? 1000 : 4 + (n * 7) % 13;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 100000;
+    uint64_t payload_bytes = 0;
+    uint8_t buf[1000];
+    uint32_t *ends; // where each frame ends on the wire
+    uint32_t i, len;
+    TinyFrame *tx, *rx;
+    double t0, t_recv;
+
+    if (argc > 1) frames = (uint32_t) atoi(argv[1]);
+    ends = malloc(frames * sizeof(uint32_t));
+    memset(buf, 0x55, sizeof(buf));
+
+    tx = TF_Init(TF_MASTER);
+    rx = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(rx, checkListener);
+
+    for (i = 0; i < frames; i++) {
+        len = frame_len(i);
+        payload_bytes += len;
+        TF_SendSimple(tx, (TF_TYPE) (0x10 + (len & 0x0F)), buf, (TF_LEN) len);
+        ends[i] = wire_len;
+    }
+
+    t_recv = 0;
+    for (i = 0; i < frames; i++) {
+        expected_len = frame_len(i);
+        t0 = now();
+        TF_Accept(rx, wire + (i ? ends[i - 1] : 0), ends[i] - (i ? ends[i - 1] : 0));
+        t_recv += now() - t0;
+    }
+
+    printf("TF_USE_VARINT=%d, TF_LEN_BYTES=%d, %d frames, %s\n", TF_USE_VARINT, TF_LEN_BYTES, (int)frames,
+           received == frames && received_ok ? "OK" : "FAIL!!!!");
+    printf("  overhead       %.2f bytes per frame\n", (double)(wire_len - payload_bytes) / frames);
+    printf("  wire bytes     %.1f per frame (%.1f %% payload)\n", (double)wire_len / frames, 100.0 * payload_bytes / wire_len);
+    printf("  frames/s       %.0f at %d baud\n", BAUD / 10.0 / ((double)wire_len / frames), BAUD);
+    printf("  receive        %.0f ns/frame\n", t_recv * 1e9 / frames);
+
+    TF_DeInit(tx);
+    TF_DeInit(rx);
+    free(wire);
+    free(ends);
+    return 0;
+}
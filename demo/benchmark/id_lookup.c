@@ -0,0 +1,111 @@
+//
+// Cost of receiving a response vs. the number of pending ID listeners,
+// with the ID listener table scan (id_linear.bin) or TF_USE_ID_HASH (id_hash.bin).
+//
+// Usage: id_*.bin [frames]
+//
+// The responses are for random listeners out of those pending, so a scan
+// goes through half of the table on average.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../TinyFrame.h"
+
+#define DISTINCT_FRAMES 4096
+
+static uint8_t *wire;
+static uint32_t wire_len;
+static uint32_t received;
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    wire = realloc(wire, wire_len + len);
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+static TF_Result responseListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    (void)msg;
+    received++;
+    return TF_STAY;
+}
+
+/** Frame ID of the n-th listener - spread over the ID space, all distinct */
+static TF_ID listener_id(uint32_t n)
+{
+    return (TF_ID) ((n * 40503u) & 0x7FFF);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 1000000;
+    uint32_t counts[] = {1, 4, 16, 64, 256, 1024};
+    uint32_t count, c, i, rounds;
+    uint8_t payload[4] = {1, 2, 3, 4};
+    TinyFrame *rx, *tx;
+    TF_Msg msg;
+    double t0, t1;
+
+    if (argc > 1) frames = (uint32_t) atoi(argv[1]);
+    rounds = (frames + DISTINCT_FRAMES - 1) / DISTINCT_FRAMES;
+
+    printf("TF_USE_ID_HASH=%d, %d frames\n", TF_USE_ID_HASH, (int)(rounds * DISTINCT_FRAMES));
+    printf("%10s %12s\n", "listeners", "ns/frame");
+
+    srand(1);
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        count = counts[c];
+        if (count > TF_MAX_ID_LST) break;
+
+        rx = TF_Init(TF_MASTER);
+        tx = TF_Init(TF_SLAVE);
+
+        for (i = 0; i < count; i++) {
+            TF_ClearMsg(&msg);
+            msg.frame_id = listener_id(i);
+            TF_AddIdListener(rx, &msg, responseListener, NULL, 0);
+        }
+
+        // responses to random pending queries
+        wire_len = 0;
+        for (i = 0; i < DISTINCT_FRAMES; i++) {
+            TF_ClearMsg(&msg);
+            msg.frame_id = listener_id((uint32_t) rand() % count);
+            msg.type = 0x22;
+            msg.data = payload;
+            msg.len = sizeof(payload);
+            TF_Respond(tx, &msg);
+        }
+
+        received = 0;
+        t0 = now();
+        for (i = 0; i < rounds; i++) {
+            TF_Accept(rx, wire, wire_len);
+        }
+        t1 = now();
+
+        if (received != rounds * DISTINCT_FRAMES) {
+            printf("lost %d frames!\n", (int)(rounds * DISTINCT_FRAMES - received));
+        }
+        printf("%10d %12.1f\n", (int)count, (t1 - t0) * 1e9 / received);
+
+        TF_DeInit(rx);
+        TF_DeInit(tx);
+    }
+
+    free(wire);
+    return 0;
+}
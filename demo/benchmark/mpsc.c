@@ -0,0 +1,175 @@
+//
+// Many threads sending frames to one link: TF_SendSimple() serialized by
+// the Tx mutex, vs. TF_EncodeFrame() + TF_Submit() to the lock-free queue
+// drained by one writer thread.
+//
+// Usage: mpsc.bin [max threads]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../../TinyFrame.h"
+
+#define TOTAL_FRAMES 400000
+#define PAYLOAD_LEN 32
+#define FRAME_LEN (PAYLOAD_LEN + 32)
+#define NODES_PER_THREAD 64
+
+static pthread_mutex_t tx_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static TinyFrame *tf;
+static uint32_t thread_count;
+static uint8_t sink[256];
+static uint32_t frames_written; // only written with the Tx lock held
+
+bool TF_ClaimTx(TinyFrame *tf)
+{
+    (void)tf;
+    pthread_mutex_lock(&tx_mutex);
+    return true;
+}
+
+void TF_ReleaseTx(TinyFrame *tf)
+{
+    (void)tf;
+    pthread_mutex_unlock(&tx_mutex);
+}
+
+/** Each call is one whole frame here (the send buffer is larger than a frame) */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    memcpy(sink, buff, len);
+    frames_written++;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Send with TF_SendSimple(), through the mutex */
+static void *mutexSender(void *arg)
+{
+    uint8_t payload[PAYLOAD_LEN];
+    uint32_t i;
+    (void)arg;
+
+    memset(payload, 0x55, sizeof(payload));
+    for (i = 0; i < TOTAL_FRAMES / thread_count; i++) {
+        TF_SendSimple(tf, 0x22, payload, PAYLOAD_LEN);
+    }
+    return NULL;
+}
+
+struct SenderNode {
+    TF_TxNode node;
+    uint8_t busy; // set until the writer is done with it
+    uint8_t buf[FRAME_LEN];
+};
+
+static void nodeDone(TinyFrame *tf, TF_TxNode *node)
+{
+    (void)tf;
+    __atomic_store_n(&((struct SenderNode *) node->userdata)->busy, 0, __ATOMIC_RELEASE);
+}
+
+/** Encode in own buffers and submit */
+static void *mpscSender(void *arg)
+{
+    struct SenderNode *nodes = calloc(NODES_PER_THREAD, sizeof(struct SenderNode));
+    struct SenderNode *sn;
+    uint8_t payload[PAYLOAD_LEN];
+    TF_Msg msg;
+    uint32_t i;
+    (void)arg;
+
+    memset(payload, 0x55, sizeof(payload));
+    for (i = 0; i < TOTAL_FRAMES / thread_count; i++) {
+        sn = &nodes[i % NODES_PER_THREAD];
+        while (__atomic_load_n(&sn->busy, __ATOMIC_ACQUIRE)) {
+            sched_yield(); // all buffers are queued, wait for the writer
+        }
+
+        TF_ClearMsg(&msg);
+        msg.type = 0x22;
+        msg.data = payload;
+        msg.len = PAYLOAD_LEN;
+        sn->node.data = sn->buf;
+        sn->node.len = TF_EncodeFrame(tf, &msg, sn->buf, sizeof(sn->buf));
+        sn->node.done = nodeDone;
+        sn->node.userdata = sn;
+        sn->busy = 1;
+        TF_Submit(tf, &sn->node);
+    }
+
+    // wait until the writer is done with the buffers
+    for (i = 0; i < NODES_PER_THREAD; i++) {
+        while (__atomic_load_n(&nodes[i].busy, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+    }
+    free(nodes);
+    return NULL;
+}
+
+/** Run the senders, return frames/s */
+static double run(void *(*sender)(void *), bool writer)
+{
+    pthread_t *threads = malloc(sizeof(pthread_t) * thread_count);
+    uint32_t expected = TOTAL_FRAMES / thread_count * thread_count;
+    double t0, t1;
+    uint32_t i;
+
+    tf = TF_Init(TF_MASTER);
+    frames_written = 0;
+
+    t0 = now();
+    for (i = 0; i < thread_count; i++) {
+        pthread_create(&threads[i], NULL, sender, NULL);
+    }
+    if (writer) {
+        // this thread is the writer
+        while (__atomic_load_n(&frames_written, __ATOMIC_RELAXED) < expected) {
+            if (TF_WriteSubmitted(tf, 0) == 0) sched_yield();
+        }
+    }
+    for (i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    t1 = now();
+
+    if (frames_written != expected) {
+        printf("lost %d frames!\n", (int)(expected - frames_written));
+    }
+
+    TF_DeInit(tf);
+    free(threads);
+    return expected / (t1 - t0);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t max_threads = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+    double mutex_rate, mpsc_rate;
+
+    if (argc > 1) max_threads = (uint32_t) atoi(argv[1]);
+
+    printf("%d frames of %d bytes to one link, %ld CPUs\n", TOTAL_FRAMES, PAYLOAD_LEN, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s %14s %14s\n", "threads", "mutex fr/s", "mpsc fr/s");
+
+    for (thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        mutex_rate = run(mutexSender, false);
+        mpsc_rate = run(mpscSender, true);
+        printf("%8d %14.0f %14.0f\n", (int)thread_count, mutex_rate, mpsc_rate);
+    }
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+//
+// Goodput of reliable delivery over a lossy link with latency, stop-and-wait
+// (TF_REL_WINDOW=1) vs. a window of messages waiting for an ack.
+//
+// One tick is the time to send a frame. A frame arrives LATENCY ticks after
+// it was sent, or is lost with probability LOSS. Frames in each direction are
+// sent one after another. Goodput is the share of the ticks the sender's wire
+// carried new messages.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+
+#define MESSAGES 10000
+#define MSG_LEN 32
+#define LATENCY 10
+#define LOSS 0.05
+#define QUEUE_LEN 256
+
+/** Frames on the way in one direction */
+struct link {
+    TinyFrame *to;
+    uint32_t free_at; // when the wire is free to send the next frame
+    uint32_t frames;  // frames sent
+    struct {
+        uint32_t due;
+        uint32_t len;
+        uint8_t data[64];
+    } queue[QUEUE_LEN];
+    uint32_t head, tail;
+};
+
+static TinyFrame *master_tf;
+static TinyFrame *slave_tf;
+static struct link to_slave, to_master;
+static uint32_t now;
+static uint32_t received;
+static uint32_t in_order = 1;
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    struct link *l = (tf == master_tf) ? &to_slave : &to_master;
+
+    // the frames are short, each is written at once
+    if (l->free_at < now) l->free_at = now;
+    l->free_at++;
+    l->frames++;
+
+    if ((double) rand() / RAND_MAX < LOSS) return;
+
+    l->queue[l->head].due = l->free_at + LATENCY;
+    l->queue[l->head].len = len;
+    memcpy(l->queue[l->head].data, buff, len);
+    l->head = (l->head + 1) % QUEUE_LEN;
+}
+
+/** Pass on the frames that arrived by now */
+static void deliver(struct link *l)
+{
+    while (l->tail != l->head && l->queue[l->tail].due <= now) {
+        TF_Accept(l->to, l->queue[l->tail].data, l->queue[l->tail].len);
+        l->tail = (l->tail + 1) % QUEUE_LEN;
+    }
+}
+
+static TF_Result slaveListener(TinyFrame *tf, TF_Msg *msg)
+{
+    uint32_t nr;
+    (void)tf;
+    memcpy(&nr, msg->data, sizeof(nr));
+    if (nr != received) in_order = 0;
+    received++;
+    return TF_STAY;
+}
+
+int main(void)
+{
+    uint8_t payload[MSG_LEN];
+    uint32_t sent = 0;
+    TF_Msg msg;
+
+    srand(1);
+    memset(payload, 'x', sizeof(payload));
+
+    master_tf = TF_Init(TF_MASTER);
+    slave_tf = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(slave_tf, slaveListener);
+    to_slave.to = slave_tf;
+    to_master.to = master_tf;
+
+    while (received < MESSAGES) {
+        deliver(&to_slave);
+        deliver(&to_master);
+        TF_Tick(master_tf);
+        TF_Tick(slave_tf);
+
+        // a new message when the wire is free
+        if (sent < MESSAGES && to_slave.free_at <= now && TF_ReliableFree(master_tf) > 0) {
+            memcpy(payload, &sent, sizeof(sent));
+            TF_ClearMsg(&msg);
+            msg.type = 0x20;
+            msg.data = payload;
+            msg.len = MSG_LEN;
+            if (TF_SendReliable(master_tf, &msg, NULL)) sent++;
+        }
+        now++;
+    }
+
+    printf("TF_REL_WINDOW=%d, %d messages, %d %% loss, latency %d ticks, %s\n",
+           TF_REL_WINDOW, MESSAGES, (int)(LOSS * 100), LATENCY, in_order ? "OK" : "FAIL!!!!");
+    printf("  ticks          %d\n", (int)now);
+    printf("  goodput        %.1f %% of the link rate\n", 100.0 * MESSAGES / now);
+    printf("  frames sent    %d (%.1f per message)\n", (int)to_slave.frames, (double)to_slave.frames / MESSAGES);
+    printf("  acks sent      %d\n", (int)to_master.frames);
+
+    TF_DeInit(master_tf);
+    TF_DeInit(slave_tf);
+    return 0;
+}
@@ -0,0 +1,163 @@
+//
+// Frame loss on a noisy line, with SOF framing (without or with TF_USE_RESYNC)
+// or COBS framing (TF_USE_COBS).
+//
+// A stream of frames is corrupted by random bit flips and parsed again.
+// Every frame lost beyond the one hit by the error is caused by the
+// parser losing sync. The time to parse the clean stream is measured too.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../TinyFrame.h"
+
+#define FRAME_COUNT 100000
+#define MAX_LEN 48
+
+static uint8_t *wire;
+static uint32_t wire_len;
+static uint32_t wire_size;
+
+static uint8_t seen[FRAME_COUNT];
+static uint32_t good;
+static uint32_t bogus;
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** Fill a payload for frame nr. seq - 4 bytes of the number, then bytes derived from it */
+static TF_LEN make_payload(uint32_t seq, uint8_t *buf)
+{
+    uint32_t state = seq * 2654435761u + 1;
+    TF_LEN len = (TF_LEN) (4 + seq % (MAX_LEN - 4));
+    TF_LEN i;
+
+    memcpy(buf, &seq, 4);
+    for (i = 4; i < len; i++) {
+        state = state * 1103515245u + 12345u;
+        buf[i] = (uint8_t) (state >> 16);
+    }
+    return len;
+}
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    if (wire_len + len > wire_size) {
+        wire_size = (wire_len + len) * 2;
+        wire = realloc(wire, wire_size);
+    }
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+/** Count frames that arrived intact, and corrupted frames that got through */
+static TF_Result checkListener(TinyFrame *tf, TF_Msg *msg)
+{
+    uint8_t expected[MAX_LEN];
+    uint32_t seq;
+    (void)tf;
+
+    if (msg->len >= 4) {
+        memcpy(&seq, msg->data, 4);
+        if (seq < FRAME_COUNT && !seen[seq]
+            && make_payload(seq, expected) == msg->len
+            && memcmp(expected, msg->data, msg->len) == 0) {
+            seen[seq] = 1;
+            good++;
+            return TF_STAY;
+        }
+    }
+    bogus++;
+    return TF_STAY;
+}
+
+int main(void)
+{
+    static const double rates[] = {1e-5, 3e-5, 1e-4, 3e-4, 1e-3};
+    uint8_t payload[MAX_LEN];
+    uint8_t *clean;
+    TinyFrame *tx, *rx;
+    uint32_t seq, i, errors, pos;
+    uint32_t r;
+    uint64_t payload_len;
+    double t0;
+
+    tx = TF_Init(TF_MASTER);
+    for (seq = 0; seq < FRAME_COUNT; seq++) {
+        TF_SendSimple(tx, 0x22, payload, make_payload(seq, payload));
+    }
+    clean = malloc(wire_len);
+    memcpy(clean, wire, wire_len);
+
+    payload_len = 0;
+    for (seq = 0; seq < FRAME_COUNT; seq++) {
+        payload_len += make_payload(seq, payload);
+    }
+
+    rx = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(rx, checkListener);
+    t0 = now();
+    for (pos = 0; pos < wire_len; pos += 64) {
+        TF_Accept(rx, wire + pos, wire_len - pos < 64 ? wire_len - pos : 64);
+    }
+    t0 = now() - t0;
+    TF_DeInit(rx);
+
+#if TF_USE_COBS
+    printf("TF_USE_COBS=1, %d frames, %d bytes", FRAME_COUNT, (int)wire_len);
+#else
+    printf("TF_USE_RESYNC=%d, %d frames, %d bytes", TF_USE_RESYNC, FRAME_COUNT, (int)wire_len);
+#endif
+    printf(" (%.2f per frame over the payload), parsed in %.1f ns/frame%s\n",
+           (double)(wire_len - payload_len) / FRAME_COUNT, t0 * 1e9 / FRAME_COUNT,
+           good == FRAME_COUNT ? "" : " FAIL!!!!");
+    printf("%10s %8s %8s %14s %7s\n", "bit error", "errors", "lost", "lost per error", "bogus");
+
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        memcpy(wire, clean, wire_len);
+        memset(seen, 0, sizeof(seen));
+        good = 0;
+        bogus = 0;
+
+        // same error positions for both builds
+        rng_state = 0x12345678u + r;
+        errors = (uint32_t) (rates[r] * wire_len * 8 + 0.5);
+        for (i = 0; i < errors; i++) {
+            pos = rng() % (wire_len * 8);
+            wire[pos / 8] ^= (uint8_t) (1 << (pos % 8));
+        }
+
+        rx = TF_Init(TF_SLAVE);
+        TF_AddGenericListener(rx, checkListener);
+        for (pos = 0; pos < wire_len; pos += 64) {
+            TF_Accept(rx, wire + pos, wire_len - pos < 64 ? wire_len - pos : 64);
+        }
+        TF_DeInit(rx);
+
+        printf("%10g %8d %8d %14.3f %7d\n", rates[r], (int)errors, (int)(FRAME_COUNT - good),
+               errors ? (double)(FRAME_COUNT - good) / errors : 0.0, (int)bogus);
+    }
+
+    TF_DeInit(tx);
+    free(clean);
+    free(wire);
+    return 0;
+}
@@ -0,0 +1,96 @@
+//
+// Cost of TF_Tick() vs. the number of pending ID listeners, with the
+// countdown loop (tick_loop.bin) or TF_USE_TIMER_WHEEL (tick_wheel.bin).
+//
+// Usage: tick_*.bin [ticks]
+//
+// The listeners have timeouts of 1000 to 2000 ticks and are renewed when
+// they expire, like queries that are re-sent, so some expire on most ticks.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../TinyFrame.h"
+
+static TinyFrame *tf;
+static uint32_t expired;
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    (void)buff;
+    (void)len;
+}
+
+static TF_Result responseListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    (void)msg;
+    return TF_STAY;
+}
+
+static TF_Result timeoutListener(TinyFrame *tf)
+{
+    (void)tf;
+    expired++;
+    return TF_CLOSE;
+}
+
+/** Add a listener that will time out in 1000 to 2000 ticks */
+static void add_listener(uint32_t n)
+{
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.frame_id = (TF_ID) (n & 0x7FFF);
+    TF_AddIdListener(tf, &msg, responseListener, timeoutListener, (TF_TICKS) (1000 + rand() % 1000));
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t ticks = 200000;
+    uint32_t counts[] = {1, 16, 64, 256, 1024};
+    uint32_t count, c, i, t, n;
+    double t0, t1;
+
+    if (argc > 1) ticks = (uint32_t) atoi(argv[1]);
+
+    printf("TF_USE_TIMER_WHEEL=%d, %d ticks\n", TF_USE_TIMER_WHEEL, (int)ticks);
+    printf("%10s %12s %12s\n", "listeners", "ns/tick", "expired");
+
+    srand(1);
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        count = counts[c];
+        if (count > TF_MAX_ID_LST) break;
+
+        tf = TF_Init(TF_MASTER);
+        for (i = 0; i < count; i++) {
+            add_listener(i);
+        }
+
+        expired = 0;
+        n = count;
+        t0 = now();
+        for (t = 0; t < ticks; t++) {
+            TF_Tick(tf);
+            // replace the expired ones
+            while (n - count < expired) {
+                add_listener(n++);
+            }
+        }
+        t1 = now();
+
+        printf("%10d %12.1f %12d\n", (int)count, (t1 - t0) * 1e9 / ticks, (int)expired);
+        TF_DeInit(tf);
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+//
+// Cost of receiving a frame vs. the number of Type listeners, with each
+// TF_TYPE_DISPATCH strategy (type_linear.bin, type_sorted.bin, type_direct.bin).
+//
+// Usage: type_*.bin [frames]
+//
+// The frames have random types out of those listened for.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../../TinyFrame.h"
+
+#define DISTINCT_FRAMES 4096
+
+static uint8_t *wire;
+static uint32_t wire_len;
+static uint32_t received;
+
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    wire = realloc(wire, wire_len + len);
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+static TF_Result typeListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    (void)msg;
+    received++;
+    return TF_STAY;
+}
+
+/** Type of the n-th listener - registered in no particular order */
+static TF_TYPE listener_type(uint32_t n)
+{
+    return (TF_TYPE) ((n * 97u) & 0xFF);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    const char *names[] = {"linear", "sorted", "direct"};
+    uint32_t frames = 1000000;
+    uint32_t counts[] = {1, 4, 16, 64, 128};
+    uint32_t count, c, i, rounds;
+    uint8_t payload[4] = {1, 2, 3, 4};
+    TinyFrame *rx, *tx;
+    double t0, t1;
+
+    if (argc > 1) frames = (uint32_t) atoi(argv[1]);
+    rounds = (frames + DISTINCT_FRAMES - 1) / DISTINCT_FRAMES;
+
+    printf("TF_TYPE_DISPATCH %s, %d frames\n", names[TF_TYPE_DISPATCH], (int)(rounds * DISTINCT_FRAMES));
+    printf("%10s %12s\n", "listeners", "ns/frame");
+
+    srand(1);
+    for (c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        count = counts[c];
+        if (count > TF_MAX_TYPE_LST) break;
+
+        rx = TF_Init(TF_MASTER);
+        tx = TF_Init(TF_SLAVE);
+
+        for (i = 0; i < count; i++) {
+            TF_AddTypeListener(rx, listener_type(i), typeListener);
+        }
+
+        wire_len = 0;
+        for (i = 0; i < DISTINCT_FRAMES; i++) {
+            TF_SendSimple(tx, listener_type((uint32_t) rand() % count), payload, sizeof(payload));
+        }
+
+        received = 0;
+        t0 = now();
+        for (i = 0; i < rounds; i++) {
+            TF_Accept(rx, wire, wire_len);
+        }
+        t1 = now();
+
+        if (received != rounds * DISTINCT_FRAMES) {
+            printf("lost %d frames!\n", (int)(rounds * DISTINCT_FRAMES - received));
+        }
+        printf("%10d %12.1f\n", (int)count, (t1 - t0) * 1e9 / received);
+
+        TF_DeInit(rx);
+        TF_DeInit(tx);
+    }
+
+    free(wire);
+    return 0;
+}
@@ -3,12 +3,7 @@
 //
 
 #include "demo.h"
-
-// those magic defines are needed so we can use clone()
-#define _GNU_SOURCE
-#define __USE_GNU
-
-#include <sched.h>
+#include "../utilities/tf_epoll.h"
 
 #include <unistd.h>
 #include <sys/socket.h>
@@ -16,11 +11,13 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <signal.h>
-#include <malloc.h>
 #include <stdlib.h>
 
-volatile int sockfd = -1;
-volatile bool conn_disband = false;
+#define TICK_MS 10
+#define OUT_MAX 65536
+
+static TfLoop *loop;
+static TfConn *conn;
 
 TinyFrame *demo_tf;
 
@@ -29,8 +26,7 @@ TinyFrame *demo_tf;
  */
 void demo_disconn(void)
 {
-    conn_disband = true;
-    if (sockfd >= 0) close(sockfd);
+    if (conn != NULL) tfl_close(conn);
 }
 
 /**
@@ -43,84 +39,89 @@ void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
 {
     printf("\033[32mTF_WriteImpl - sending frame:\033[0m\n");
     dumpFrame(buff, len);
-    usleep(1000);
 
-    if (sockfd != -1) {
-        write(sockfd, buff, len);
+    if (conn != NULL) {
+        tfl_write(conn, buff, len);
     }
     else {
         printf("\nNo peer!\n");
     }
 }
 
+/**
+ * Connection closed by the peer, or by demo_disconn()
+ */
+static void demo_closed(TfLoop *l, TfConn *c)
+{
+    (void) l;
+    printf("Closing socket\n");
+    if (c == conn) conn = NULL;
+}
 
 /**
- * Client bg thread
+ * Connect to the server
  *
- * @param unused
- * @return unused
+ * @return success
  */
-static int demo_client(void *unused)
+static bool demo_client(void)
 {
-    (void) unused;
-
-    ssize_t n = 0;
-    uint8_t recvBuff[1024];
+    int fd;
     struct sockaddr_in serv_addr;
 
     printf("\n--- STARTING CLIENT! ---\n");
 
-    memset(recvBuff, '0', sizeof(recvBuff));
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         printf("\n Error : Could not create socket \n");
         return false;
     }
 
-    memset(&serv_addr, '0', sizeof(serv_addr));
-
+    memset(&serv_addr, 0, sizeof(serv_addr));
     serv_addr.sin_family = AF_INET;
     serv_addr.sin_port = htons(PORT);
 
     if (inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr) <= 0) {
         printf("\n inet_pton error occured\n");
+        close(fd);
         return false;
     }
 
-    if (connect(sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) {
+    if (connect(fd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) {
         printf("\n Error : Connect Failed \n");
         perror("PERROR ");
+        close(fd);
         return false;
     }
 
-    printf("\n Child Process \n");
+    conn = tfl_add(loop, fd, fd, demo_tf, demo_closed);
+    return conn != NULL;
+}
 
-    while ((n = read(sockfd, recvBuff, sizeof(recvBuff) - 1)) > 0) {
-        printf("\033[36m--- RX %ld bytes ---\033[0m\n", n);
-        dumpFrame(recvBuff, (size_t) n);
-        TF_Accept(demo_tf, recvBuff, (size_t) n);
-    }
-    return 0;
+/**
+ * New client on the server socket - it replaces the previous one
+ */
+static void demo_accepted(TfLoop *l, int fd)
+{
+    printf("\nClient connected\n");
+    if (conn != NULL) tfl_close(conn);
+    conn = tfl_add(l, fd, fd, demo_tf, demo_closed);
+    if (conn == NULL) close(fd);
 }
 
 /**
- * Server bg thread
+ * Start listening
  *
- * @param unused
- * @return unused
+ * @return success
  */
-static int demo_server(void *unused)
+static bool demo_server(void)
 {
-    (void) unused;
-    ssize_t n;
-    int listenfd = 0;
-    uint8_t recvBuff[1024];
+    int listenfd;
     struct sockaddr_in serv_addr;
     int option;
 
     printf("\n--- STARTING SERVER! ---\n");
 
     listenfd = socket(AF_INET, SOCK_STREAM, 0);
-    memset(&serv_addr, '0', sizeof(serv_addr));
+    memset(&serv_addr, 0, sizeof(serv_addr));
 
     option = 1;
     setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, (char *) &option, sizeof(option));
@@ -131,36 +132,16 @@ static int demo_server(void *unused)
 
     if (bind(listenfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0) {
         perror("Failed to bind");
-        return 1;
+        return false;
     }
 
     if (listen(listenfd, 10) < 0) {
         perror("Failed to listen");
-        return 1;
+        return false;
     }
 
-    while (1) {
-        printf("\nWaiting for client...\n");
-        sockfd = accept(listenfd, (struct sockaddr *) NULL, NULL);
-        setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, (char *) &option, sizeof(option));
-        printf("\nClient connected\n");
-        conn_disband = false;
-
-        while ((n = read(sockfd, recvBuff, sizeof(recvBuff) - 1)) > 0 && !conn_disband) {
-            printf("\033[36m--- RX %ld bytes ---\033[0m\n", n);
-            dumpFrame(recvBuff, n);
-            TF_Accept(demo_tf, recvBuff, (size_t) n);
-        }
-
-        if (n < 0) {
-            printf("\n Read error \n");
-        }
-
-        printf("Closing socket\n");
-        close(sockfd);
-        sockfd = -1;
-    }
-    return 0;
+    printf("\nWaiting for client...\n");
+    return tfl_listen(loop, listenfd, demo_accepted);
 }
 
 /**
@@ -178,15 +159,15 @@ static void signal_handler(int sig)
 }
 
 /**
- * Sleaping Beauty's fave function
+ * Sleaping Beauty's fave function - runs the event loop
  */
 void demo_sleep(void)
 {
-    while (1) usleep(10);
+    tfl_run(loop);
 }
 
 /**
- * Start the background thread
+ * Set up the connection and the event loop
  *
  * Slave is started first and doesn't normally init transactions - but it could
  *
@@ -194,33 +175,29 @@ void demo_sleep(void)
  */
 void demo_init(TF_Peer peer)
 {
+    bool ok;
+
     signal(SIGTERM, signal_handler);
     signal(SIGINT, signal_handler);
 
-    int retc;
-    void *stack = malloc(8192);
-    if (stack == NULL) {
-        perror("Oh fuck");
+    loop = tfl_create(TICK_MS, OUT_MAX);
+    if (loop == NULL) {
+        perror("Failed to create the event loop");
         signal_handler(9);
         return;
     }
 
     printf("Starting %s...\n", peer == TF_MASTER ? "MASTER" : "SLAVE");
 
-    // CLONE_VM    --- share heap
-    // CLONE_FILES --- share stdout and stderr
     if (peer == TF_MASTER) {
-        retc = clone(&demo_client, (char *) stack + 8192, CLONE_VM | CLONE_FILES, 0);
+        ok = demo_client();
     }
     else {
-        retc = clone(&demo_server, (char *) stack + 8192, CLONE_VM | CLONE_FILES, 0);
+        ok = demo_server();
     }
 
-    if (retc == 0) {
-        perror("Clone fail");
+    if (!ok) {
         signal_handler(9);
         return;
     }
-
-    printf("Thread started\n");
 }
@@ -13,10 +13,10 @@
 
 extern TinyFrame *demo_tf;
 
-/** Sleep and wait for ^C */
+/** Run the event loop, until ^C */
 void demo_sleep(void);
 
-/** Init server - DOES NOT init TinyFrame! */
+/** Connect or start the server - DOES NOT init TinyFrame! */
 void demo_init(TF_Peer peer);
 
 /** Disconnect client from the server - can be called by a server-side callback */
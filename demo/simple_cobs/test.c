@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *demo_tf;
+
+uint8_t wire[256];
+uint32_t wire_len;
+
+/** Collect the frames on the wire */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Received frame %d: %.*s\n", (int)msg->frame_id, (int)msg->len, msg->data);
+    return TF_STAY;
+}
+
+int main(void)
+{
+    const char *texts[] = {"first", "second", "third"};
+    int i;
+
+    demo_tf = TF_Init(TF_MASTER);
+    TF_AddGenericListener(demo_tf, myListener);
+
+    for (i = 0; i < 3; i++) {
+        TF_SendSimple(demo_tf, 0x22, (const uint8_t *) texts[i], (TF_LEN) strlen(texts[i]));
+    }
+
+    printf("------ The frames end with a zero, there are no zeros inside --------\n");
+    dumpFrame(wire, wire_len);
+
+    printf("------ A byte of the second frame is lost --------\n");
+    // the parser is back in sync at the next zero, the third frame is received
+    memmove(wire + 20, wire + 21, wire_len - 21);
+    TF_Accept(demo_tf, wire, wire_len - 1);
+
+    TF_DeInit(demo_tf);
+    return 0;
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *demo_tf;
+
+/** Loopback, showing the frame size */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    printf("--------------------\n");
+    printf("\033[32mTF_WriteImpl - sending frame, %d bytes:\033[0m\n", (int)len);
+    dumpFrame(buff, len);
+
+    // send to the receiver
+    TF_Accept(tf, buff, len);
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Received type 0x%02x, %d bytes: %.*s\n", (int)msg->type, (int)msg->len, (int)msg->len, msg->data);
+    return TF_STAY;
+}
+
+int main(void)
+{
+    const char *telemetry = "temp=21.5;temp=21.6;temp=21.6;temp=21.7;temp=21.7;temp=21.7;temp=21.8";
+    const char *random = "a short message";
+
+    demo_tf = TF_Init(TF_MASTER);
+    TF_AddGenericListener(demo_tf, myListener);
+
+    // Repetitive, goes in a shorter frame of type TF_COMP_TYPE
+    TF_SendSimple(demo_tf, 0x22, (const uint8_t *) telemetry, (TF_LEN) strlen(telemetry));
+
+    // Below TF_COMP_THRESHOLD, sent as it is
+    TF_SendSimple(demo_tf, 0x22, (const uint8_t *) random, (TF_LEN) strlen(random));
+
+    TF_DeInit(demo_tf);
+    return 0;
+}
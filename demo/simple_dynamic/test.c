@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+#define QUERY_COUNT 3000
+
+TinyFrame *master, *slave;
+
+// Bytes sent by the master, delivered to the slave later - so the queries pile up
+uint8_t *wire;
+uint32_t wire_len;
+
+uint32_t allocated; // bytes currently allocated for listener tables
+uint32_t responses;
+
+/**
+ * This function should be defined in the application code.
+ * It implements the lowest layer - sending bytes to UART (or other)
+ */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    if (tf == master) {
+        wire = realloc(wire, wire_len + len);
+        memcpy(wire + wire_len, buff, len);
+        wire_len += len;
+    }
+    else {
+        TF_Accept(master, buff, len);
+    }
+}
+
+/** Allocator for the listener tables - a heap with accounting */
+void *TF_Alloc(TinyFrame *tf, uint32_t size)
+{
+    uint32_t *block = malloc(sizeof(uint32_t) * 2 + size);
+    if (block == NULL) return NULL;
+    block[0] = size;
+    allocated += size;
+    return block + 2;
+}
+
+void TF_Free(TinyFrame *tf, void *ptr)
+{
+    uint32_t *block = (uint32_t *) ptr - 2;
+    allocated -= block[0];
+    free(block);
+}
+
+/** Nr of ID listeners waiting for a response */
+int pending(TinyFrame *tf)
+{
+    int i, n = 0;
+    for (i = 0; i < tf->cap_id_lst; i++) {
+        if (tf->id_listeners[i].fn != NULL) n++;
+    }
+    return n;
+}
+
+/** Slave: answer a query */
+TF_Result queryListener(TinyFrame *tf, TF_Msg *msg)
+{
+    TF_Respond(tf, msg);
+    return TF_STAY;
+}
+
+/** Master: got an answer */
+TF_Result responseListener(TinyFrame *tf, TF_Msg *msg)
+{
+    responses++;
+    return TF_CLOSE;
+}
+
+int main(void)
+{
+    int i;
+
+    master = TF_Init(TF_MASTER);
+    slave = TF_Init(TF_SLAVE);
+    TF_AddTypeListener(slave, 0x20, queryListener);
+
+    printf("Idle: %d ID listener slots, %d bytes allocated in total\n", (int)master->cap_id_lst, (int)allocated);
+
+    printf("------ Send %d queries --------\n", QUERY_COUNT);
+
+    for (i = 0; i < QUERY_COUNT; i++) {
+        if (!TF_QuerySimple(master, 0x20, NULL, 0, responseListener, NULL, 0)) {
+            printf("Query %d failed\n", i);
+            break;
+        }
+    }
+
+    printf("%d pending: %d ID listener slots, %d bytes allocated in total\n",
+           pending(master), (int)master->cap_id_lst, (int)allocated);
+
+    printf("------ Deliver them to the slave --------\n");
+
+    TF_Accept(slave, wire, wire_len);
+
+    printf("Got %d responses, %d pending\n", (int)responses, pending(master));
+
+    TF_DeInit(master);
+    TF_DeInit(slave);
+    printf("After TF_DeInit: %d bytes allocated\n", (int)allocated);
+    free(wire);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *master_tf;
+TinyFrame *slave_tf; // a slow peer, handles frames only when it gets to it
+
+bool drop_next; // simulate a frame lost on the wire
+
+/** Both instances are connected by a wire */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    if (drop_next) {
+        printf("(frame lost)\n");
+        drop_next = false;
+        return;
+    }
+    TF_Accept(tf == master_tf ? slave_tf : master_tf, buff, len);
+}
+
+/** Slave listener */
+TF_Result slaveListener(TinyFrame *tf, TF_Msg *msg)
+{
+    printf("Slave handles frame %d\n", (int)msg->frame_id);
+    if (msg->type == 0x30) {
+        TF_Respond(tf, msg);
+    }
+    return TF_STAY;
+}
+
+/** Master listener for responses */
+TF_Result responseListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Master got response %d\n", (int)msg->frame_id);
+    return TF_CLOSE;
+}
+
+/** Send frames until one is refused */
+void sendSome(int max)
+{
+    int i;
+    for (i = 0; i < max; i++) {
+        if (!TF_SendSimple(master_tf, 0x20, (const uint8_t *) "data", 4)) break;
+        printf("Master sent a frame, credit left %d\n", (int)TF_FlowCredit(master_tf));
+    }
+}
+
+int main(void)
+{
+    int i;
+
+    master_tf = TF_Init(TF_MASTER);
+    slave_tf = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(slave_tf, slaveListener);
+
+    printf("------ The slave holds up to 4 frames --------\n");
+    sendSome(10);
+
+    printf("------ It handles them, and returns credit --------\n");
+    TF_DispatchPending(slave_tf, 0);
+    sendSome(10);
+    TF_DispatchPending(slave_tf, 0);
+
+    printf("------ A frame and a grant are lost, the master asks for credit when it's due --------\n");
+    drop_next = true;
+    sendSome(10);
+    drop_next = true;
+    TF_DispatchPending(slave_tf, 0);
+    sendSome(1);
+    // a tickless host sleeps until the probe is due
+    printf("Master sleeps %d ticks\n", (int)TF_NextDeadline(master_tf));
+    TF_TickBy(master_tf, TF_NextDeadline(master_tf));
+    TF_DispatchPending(slave_tf, 0);
+    sendSome(10);
+    TF_DispatchPending(slave_tf, 0);
+
+    printf("------ At most 2 queries wait for a response --------\n");
+    for (i = 0; i < 3; i++) {
+        printf("Query: %s\n", TF_QuerySimple(master_tf, 0x30, NULL, 0, responseListener, NULL, 0) ? "sent" : "refused");
+    }
+    TF_DispatchPending(slave_tf, 0);
+    TF_DispatchPending(master_tf, 0);
+    printf("Query: %s\n", TF_QuerySimple(master_tf, 0x30, NULL, 0, responseListener, NULL, 0) ? "sent" : "refused");
+
+    TF_DeInit(master_tf);
+    TF_DeInit(slave_tf);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *demo_tf;
+
+uint8_t file_a[1000];
+uint8_t file_b[600];
+
+/**
+ * This function should be defined in the application code.
+ * It implements the lowest layer - sending bytes to UART (or other)
+ */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    // Send it back as if we received it
+    TF_Accept(tf, buff, len);
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    if (msg->type == 0x30) {
+        printf("Got file A, %d bytes, %s\n", (int)msg->len,
+               msg->len == sizeof(file_a) && memcmp(msg->data, file_a, msg->len) == 0 ? "OK" : "FAIL!!!!");
+    }
+    else if (msg->type == 0x31) {
+        printf("Got file B, %d bytes, %s\n", (int)msg->len,
+               msg->len == sizeof(file_b) && memcmp(msg->data, file_b, msg->len) == 0 ? "OK" : "FAIL!!!!");
+    }
+    else {
+        printf("Got short frame, type %d, \"%.*s\"\n", (int)msg->type, (int)msg->len, (const char *)msg->data);
+    }
+    return TF_STAY;
+}
+
+int main(void)
+{
+    TF_Msg msg;
+    uint32_t i;
+    int n = 0;
+
+    for (i = 0; i < sizeof(file_a); i++) file_a[i] = (uint8_t) (i * 7);
+    for (i = 0; i < sizeof(file_b); i++) file_b[i] = (uint8_t) (i * 13);
+
+    // Set up the TinyFrame library
+    demo_tf = TF_Init(TF_MASTER); // 1 = master, 0 = slave
+    TF_AddGenericListener(demo_tf, myListener);
+
+    printf("------ Two long messages, sent a fragment at a time --------\n");
+
+    TF_ClearMsg(&msg);
+    msg.type = 0x30;
+    msg.data = file_a;
+    msg.len = sizeof(file_a);
+    TF_Send_Fragmented(demo_tf, &msg);
+
+    TF_ClearMsg(&msg);
+    msg.type = 0x31;
+    msg.data = file_b;
+    msg.len = sizeof(file_b);
+    TF_Send_Fragmented(demo_tf, &msg);
+
+    // The transmitter isn't locked between fragments - short frames get through meanwhile
+    while (TF_SendNextFragment(demo_tf)) {
+        printf("Fragment sent\n");
+        if (++n % 2 == 0) {
+            TF_SendSimple(demo_tf, 0x10, (const uint8_t *) "ping", 4);
+        }
+    }
+
+    TF_DeInit(demo_tf);
+    return 0;
+}
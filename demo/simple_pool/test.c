@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+#define LINK_COUNT 4
+
+TinyFrame *links[LINK_COUNT];
+
+// The RX buffers shared by all links - most frames are short
+TF_RxPool pool;
+uint8_t small_bufs[32 * 4];
+uint8_t medium_bufs[128 * 2];
+uint8_t large_bufs[512 * 1];
+
+/**
+ * This function should be defined in the application code.
+ * It implements the lowest layer - sending bytes to UART (or other)
+ */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    // Send it back as if we received it
+    TF_Accept(tf, buff, len);
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    printf("Link %d got type %d, %d bytes\n", (int)tf->usertag, (int)msg->type, (int)msg->len);
+    return TF_STAY;
+}
+
+int main(void)
+{
+    TF_RxPoolClass stats;
+    uint8_t payload[500];
+    int i;
+
+    memset(payload, 'x', sizeof(payload));
+
+    TF_RxPoolInit(&pool);
+    TF_RxPoolAddClass(&pool, small_bufs, 32, 4);
+    TF_RxPoolAddClass(&pool, medium_bufs, 128, 2);
+    TF_RxPoolAddClass(&pool, large_bufs, 512, 1);
+
+    // Set up the TinyFrame instances
+    for (i = 0; i < LINK_COUNT; i++) {
+        links[i] = TF_Init(TF_MASTER);
+        links[i]->usertag = (uint32_t) i;
+        TF_SetRxPool(links[i], &pool);
+        TF_AddGenericListener(links[i], myListener);
+    }
+
+    printf("------ Receive frames of different sizes on all links --------\n");
+
+    for (i = 0; i < LINK_COUNT; i++) {
+        TF_SendSimple(links[i], 0x10, payload, 10);
+        TF_SendSimple(links[i], 0x11, payload, 100);
+        TF_SendSimple(links[i], 0x12, payload, 500);
+    }
+
+    printf("------ Pool usage --------\n");
+
+    for (i = 0; TF_RxPoolGetStats(&pool, (uint8_t) i, &stats); i++) {
+        printf("%4d B x %d: in use %d, peak %d, exhausted %d\n",
+               (int)stats.size, (int)stats.count, (int)stats.in_use, (int)stats.peak, (int)stats.exhausted);
+    }
+    printf("Dropped: %d\n", (int)pool.failed);
+    return 0;
+}
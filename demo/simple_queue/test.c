@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *demo_tf;
+
+/**
+ * This function should be defined in the application code.
+ * It implements the lowest layer - sending bytes to UART (or other)
+ */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    // Send it back as if we received it.
+    // This would normally run in an interrupt or a reader thread.
+    TF_Accept(tf, buff, len);
+    printf("Received %d bytes\n", (int)len);
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Listener: type %d, \"%.*s\"\n", (int)msg->type, (int)msg->len, (const char *)msg->data);
+    return TF_STAY;
+}
+
+int main(void)
+{
+    uint32_t n;
+
+    // Set up the TinyFrame library
+    demo_tf = TF_Init(TF_MASTER); // 1 = master, 0 = slave
+    TF_AddGenericListener(demo_tf, myListener);
+
+    printf("------ Receive frames - they're only queued --------\n");
+
+    TF_SendSimple(demo_tf, 0x10, (pu8) "first", 5);
+    TF_SendSimple(demo_tf, 0x11, (pu8) "second", 6);
+    TF_SendSimple(demo_tf, 0x12, (pu8) "third", 5);
+    TF_SendSimple(demo_tf, 0x13, (pu8) "fourth", 6); // the queue holds only 3
+
+    printf("------ Run the listeners from the main loop --------\n");
+
+    n = TF_DispatchPending(demo_tf, 2);
+    printf("Dispatched %d\n", (int)n);
+    n = TF_DispatchPending(demo_tf, 0);
+    printf("Dispatched %d, dropped %d\n", (int)n, (int)demo_tf->rxq_dropped);
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *master_tf;
+TinyFrame *slave_tf;
+
+int frame_nr;   // frames put on the wire so far
+int drop_nr;    // a frame to lose on the way, 0 = none
+bool link_down; // lose all frames
+int drop_every; // lose every n-th frame, 0 = none
+
+/** Both instances are connected by a wire that sometimes loses a frame */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    // the frames are short, each is written at once
+    frame_nr++;
+    if (link_down || frame_nr == drop_nr || (drop_every && frame_nr % drop_every == 0)) {
+        printf("(frame lost)\n");
+        return;
+    }
+    TF_Accept(tf == master_tf ? slave_tf : master_tf, buff, len);
+}
+
+/** Slave listener */
+TF_Result slaveListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Slave got \"%.*s\"\n", (int)msg->len, msg->data);
+    return TF_STAY;
+}
+
+/** Called when the slave has the message, or the master gave up */
+TF_Result doneListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    if (msg->data == NULL) {
+        printf("Master: \"%s\" was not delivered\n", (const char *)msg->userdata);
+    } else {
+        printf("Master: \"%.*s\" delivered\n", (int)msg->len, msg->data);
+    }
+    return TF_STAY;
+}
+
+void sendText(const char *text)
+{
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.type = 0x20;
+    msg.data = (const uint8_t *) text;
+    msg.len = (TF_LEN) strlen(text);
+    msg.userdata = (void *) text;
+    if (!TF_SendReliable(master_tf, &msg, doneListener)) {
+        printf("Master: no room for \"%s\"\n", text);
+    }
+}
+
+void tick(int n)
+{
+    while (n-- > 0) {
+        TF_Tick(master_tf);
+        TF_Tick(slave_tf);
+    }
+}
+
+/** Sleep until the nearest deadline of either side, then catch up - no periodic tick */
+void runTickless(void)
+{
+    TF_TICKS m, s, elapsed;
+    int total = 0;
+
+    for (;;) {
+        m = TF_NextDeadline(master_tf);
+        s = TF_NextDeadline(slave_tf);
+        if (m == 0 && s == 0) break; // nothing pending, sleep until there's something to send
+
+        elapsed = (m == 0 || (s != 0 && s < m)) ? s : m;
+        total += elapsed;
+        TF_TickBy(master_tf, elapsed);
+        TF_TickBy(slave_tf, elapsed);
+    }
+    printf("(idle after %d ticks)\n", total);
+}
+
+int main(void)
+{
+    const char *texts[] = {"eleven", "twelve", "thirteen", "fourteen", "fifteen", "sixteen"};
+    int i;
+
+    master_tf = TF_Init(TF_MASTER);
+    slave_tf = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(slave_tf, slaveListener);
+
+    printf("------ Acks come after every 2 messages, or on a tick --------\n");
+    sendText("one");
+    sendText("two");
+    sendText("three");
+    tick(1);
+
+    printf("------ A message is lost, the next ones wait for it --------\n");
+    drop_nr = frame_nr + 1;
+    sendText("four");
+    sendText("five");
+    sendText("six");
+    sendText("seven");
+    sendText("eight"); // the window is full
+    tick(3);           // only "four" is sent again
+    sendText("eight");
+    tick(1);
+
+    printf("------ The link is down, the master gives up --------\n");
+    link_down = true;
+    sendText("nine");
+    tick(10);
+    link_down = false;
+    sendText("ten");
+    tick(1);
+
+    printf("------ Tickless, every 3rd frame is lost --------\n");
+    drop_every = 3;
+    for (i = 0; i < 6; i++) {
+        sendText(texts[i]);
+        if (TF_ReliableFree(master_tf) == 0) runTickless();
+    }
+    runTickless();
+
+    TF_DeInit(master_tf);
+    TF_DeInit(slave_tf);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *demo_tf;
+
+#define FILE_LEN 5000
+static uint8_t file[FILE_LEN];
+static uint32_t received;
+static bool matches;
+
+/**
+ * This function should be defined in the application code.
+ * It implements the lowest layer - sending bytes to UART (or other)
+ */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    printf("\033[32mTF_WriteImpl - sending %d bytes\033[0m\n", (int)len);
+
+    // Send it back as if we received it
+    TF_Accept(tf, buff, len);
+}
+
+/** A stream listener - gets the payload in pieces, as it arrives */
+void myStreamListener(TinyFrame *tf, TF_Msg *msg, TF_StreamEvent event, TF_LEN offset)
+{
+    (void)tf;
+    switch (event) {
+        case TF_STREAM_DATA:
+            printf("Piece at %d, %d bytes\n", (int)offset, (int)msg->len);
+            if (offset == 0) matches = true;
+            if (memcmp(msg->data, &file[offset], msg->len) != 0) matches = false;
+            received += msg->len;
+            break;
+
+        case TF_STREAM_END:
+            printf("Frame done, %d bytes total\n", (int)msg->len);
+            if (matches && received == FILE_LEN) {
+                printf("FILE TRANSFERRED OK!\r\n");
+            }
+            else {
+                printf("FAIL!!!!\r\n");
+            }
+            break;
+
+        case TF_STREAM_ERROR:
+            printf("Frame broken after %d bytes\n", (int)offset);
+            break;
+    }
+}
+
+void main(void)
+{
+    TF_Msg msg;
+    int i;
+
+    for (i = 0; i < FILE_LEN; i++) {
+        file[i] = (uint8_t) (i * 7 + (i >> 8));
+    }
+
+    // Set up the TinyFrame library
+    demo_tf = TF_Init(TF_MASTER); // 1 = master, 0 = slave
+    TF_AddStreamListener(demo_tf, 0x22, myStreamListener);
+
+    printf("------ Stream a payload larger than TF_MAX_PAYLOAD_RX --------\n");
+
+    TF_ClearMsg(&msg);
+    msg.type = 0x22;
+    msg.data = file;
+    msg.len = FILE_LEN;
+    TF_Send(demo_tf, &msg);
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+#define DMA_SIZE 64
+
+#define PRIO_BULK    0
+#define PRIO_CONTROL 1
+
+#define TYPE_LOG       0x40
+#define TYPE_HEARTBEAT 0x02
+
+TinyFrame *demo_tf; // sends frames to the queue
+TinyFrame *peer_tf; // receives what comes out of the queue
+
+uint32_t wire_time; // nr of bytes sent so far, used as the clock
+
+/** Time source for the TX statistics - here in byte times */
+uint32_t TF_TxTimestamp(TinyFrame *tf)
+{
+    (void)tf;
+    return wire_time;
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Peer got type 0x%02x, %d bytes at t=%d\n", (int)msg->type, (int)msg->len, (int)wire_time);
+    return TF_STAY;
+}
+
+/** Simulate one DMA transfer to the peer */
+bool runDma(void)
+{
+    const uint8_t *data;
+    uint32_t len;
+
+    len = TF_TxDrain(demo_tf, &data, DMA_SIZE);
+    if (len == 0) return false;
+
+    wire_time += len;
+    TF_Accept(peer_tf, data, len);
+    TF_TxComplete(demo_tf, len);
+    return true;
+}
+
+int main(void)
+{
+    uint8_t payload[300];
+    TF_TxStats stats;
+    TF_Msg msg;
+    int i;
+
+    memset(payload, 'x', sizeof(payload));
+
+    demo_tf = TF_Init(TF_MASTER);
+    peer_tf = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(peer_tf, myListener);
+
+    printf("------ A log upload fills the bulk queue --------\n");
+    for (i = 0; i < 3; i++) {
+        TF_SendSimple(demo_tf, TYPE_LOG, payload, sizeof(payload));
+    }
+
+    // The link starts sending the first log frame
+    runDma();
+
+    printf("------ Control frames overtake it at the next frame boundary --------\n");
+    TF_ClearMsg(&msg);
+    msg.type = TYPE_HEARTBEAT;
+    msg.priority = PRIO_CONTROL;
+    TF_Send(demo_tf, &msg);
+
+    // Class set by TF_TX_TYPE_PRIORITY() in the config
+    TF_SendSimple(demo_tf, TYPE_ESTOP, NULL, 0);
+
+    while (runDma());
+
+    printf("------ Queueing delay in byte times --------\n");
+    for (i = 0; i < TF_TX_PRIORITIES; i++) {
+        TF_TxGetStats(demo_tf, (uint8_t) i, &stats);
+        printf("Class %d: %d frames, %d bytes, delay avg %d, max %d\n", i,
+               (int)stats.frames, (int)stats.bytes,
+               stats.frames ? (int)(stats.delay_sum / stats.frames) : 0, (int)stats.delay_max);
+    }
+
+    TF_DeInit(demo_tf);
+    TF_DeInit(peer_tf);
+    return 0;
+}
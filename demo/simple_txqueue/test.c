@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+#define DMA_SIZE 24
+
+TinyFrame *demo_tf; // sends frames to the queue
+TinyFrame *peer_tf; // receives what comes out of the queue
+
+/** Called when a frame has left the queue */
+void txDone(TinyFrame *tf, TF_ID frame_id, void *userdata)
+{
+    (void)tf;
+    printf("Frame %d sent (%s)\n", (int)frame_id, (const char *) userdata);
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Peer got frame %d, type %d, %d bytes\n", (int)msg->frame_id, (int)msg->type, (int)msg->len);
+    return TF_STAY;
+}
+
+/**
+ * Simulate a DMA transfer to the peer, as if started whenever the link is idle,
+ * and TF_TxComplete() called from its interrupt
+ */
+void runDma(void)
+{
+    const uint8_t *data;
+    uint32_t len;
+
+    while ((len = TF_TxDrain(demo_tf, &data, DMA_SIZE)) > 0) {
+        printf("DMA: %d bytes\n", (int)len);
+        TF_Accept(peer_tf, data, len);
+        TF_TxComplete(demo_tf, len);
+    }
+}
+
+int main(void)
+{
+    uint8_t payload[100];
+    TF_Msg msg;
+    int i;
+
+    memset(payload, 'x', sizeof(payload));
+
+    demo_tf = TF_Init(TF_MASTER);
+    peer_tf = TF_Init(TF_SLAVE);
+    TF_AddGenericListener(peer_tf, myListener);
+
+    printf("------ Frames are queued, nothing is sent yet --------\n");
+
+    for (i = 0; i < 3; i++) {
+        TF_ClearMsg(&msg);
+        msg.type = (TF_TYPE) (0x10 + i);
+        msg.data = payload;
+        msg.len = (TF_LEN) (20 * (i + 1));
+        msg.tx_done = txDone;
+        msg.userdata = (void *) (i == 0 ? "first" : i == 1 ? "second" : "third");
+        printf("Send type %d: %s\n", (int)msg.type, TF_Send(demo_tf, &msg) ? "queued" : "failed");
+    }
+
+    // No callback for this one
+    TF_SendSimple(demo_tf, 0x20, payload, 10);
+
+    // Too large for the remaining space
+    printf("Send 100 bytes: %s\n", TF_SendSimple(demo_tf, 0x21, payload, 100) ? "queued" : "failed");
+
+    printf("------ The link pulls the bytes --------\n");
+    runDma();
+
+    printf("------ Now there's space --------\n");
+    printf("Send 100 bytes: %s\n", TF_SendSimple(demo_tf, 0x21, payload, 100) ? "queued" : "failed");
+    runDma();
+
+    TF_DeInit(demo_tf);
+    TF_DeInit(peer_tf);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *demo_tf;
+
+uint8_t wire[1024];
+uint32_t wire_len;
+
+/** Collect the frames on the wire */
+void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
+{
+    (void)tf;
+    memcpy(wire + wire_len, buff, len);
+    wire_len += len;
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Received type 0x%04x, %d bytes\n", (int)msg->type, (int)msg->len);
+    return TF_STAY;
+}
+
+int main(void)
+{
+    uint8_t payload[300];
+
+    memset(payload, 'x', sizeof(payload));
+
+    demo_tf = TF_Init(TF_MASTER);
+    TF_AddGenericListener(demo_tf, myListener);
+
+    printf("------ Short frame: LEN and TYPE take a byte each, not 4 and 2 --------\n");
+    TF_SendSimple(demo_tf, 0x22, (const uint8_t *) "hello", 5);
+    dumpFrame(wire, wire_len);
+    TF_Accept(demo_tf, wire, wire_len);
+
+    printf("------ Longer frame with a larger type: 2 bytes each --------\n");
+    wire_len = 0;
+    TF_SendSimple(demo_tf, 0x1234, payload, sizeof(payload));
+    printf("Head: %02x | %02x | %02x %02x | %02x %02x | ...\n",
+           wire[0], wire[1], wire[2], wire[3], wire[4], wire[5]);
+    TF_Accept(demo_tf, wire, wire_len);
+
+    printf("------ A corrupted LEN that never ends is dropped --------\n");
+    memcpy(wire, "\x01\x00\xff\xff\xff\xff\xff\xff", 8);
+    TF_Accept(demo_tf, wire, 8);
+
+    TF_DeInit(demo_tf);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <string.h>
+#include "../../TinyFrame.h"
+#include "../utils.h"
+
+TinyFrame *demo_tf;
+
+uint8_t payload[4000];
+
+/**
+ * This function should be defined in the application code.
+ * It implements the lowest layer - here with writev(), the pieces are gathered instead.
+ */
+void TF_WriteImplV(TinyFrame *tf, const TF_IoVec *iov, uint8_t count)
+{
+    uint8_t buff[TF_MAX_PAYLOAD_RX + 32];
+    uint32_t len = 0;
+    uint8_t i;
+
+    printf("TF_WriteImplV - %d pieces:", (int)count);
+    for (i = 0; i < count; i++) {
+        printf(" %d%s", (int)iov[i].len, iov[i].base >= payload && iov[i].base < payload + sizeof(payload) ? " (in place)" : "");
+        memcpy(buff + len, iov[i].base, iov[i].len);
+        len += iov[i].len;
+    }
+    printf("\n");
+
+    // Send it back as if we received it
+    TF_Accept(tf, buff, len);
+}
+
+/** An example listener function */
+TF_Result myListener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+    printf("Got type %d, %d bytes, %s\n", (int)msg->type, (int)msg->len,
+           msg->len == 0 || memcmp(msg->data, payload, msg->len) == 0 ? "OK" : "FAIL!!!!");
+    return TF_STAY;
+}
+
+int main(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t) (i * 7);
+    }
+
+    // Set up the TinyFrame library
+    demo_tf = TF_Init(TF_MASTER); // 1 = master, 0 = slave
+    TF_AddGenericListener(demo_tf, myListener);
+
+    printf("------ Frames go out in one call, larger than the send buffer --------\n");
+
+    TF_SendSimple(demo_tf, 0x10, NULL, 0);
+    TF_SendSimple(demo_tf, 0x11, payload, 10);
+    TF_SendSimple(demo_tf, 0x12, payload, sizeof(payload));
+
+    printf("------ Multipart frame - each piece is sent in place --------\n");
+
+    TF_SendSimple_Multipart(demo_tf, 0x13, 3000);
+    for (i = 0; i < 3000; i += 1000) {
+        TF_Multipart_Payload(demo_tf, payload + i, 1000);
+    }
+    TF_Multipart_Close(demo_tf);
+
+    TF_DeInit(demo_tf);
+    return 0;
+}
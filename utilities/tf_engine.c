@@ -0,0 +1,311 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for pthread_setaffinity_np()
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "tf_engine.h"
+
+#define LOAD_ACQ(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define STORE_REL(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+
+struct tfe_worker {
+    TfEngine *engine;
+    uint32_t index;
+    pthread_t thread;
+    sem_t sem;             //!< Posted when there may be work
+    uint32_t signalled;    //!< Set when the semaphore was posted, so it's posted only once
+    uint32_t ticks_done;   //!< Ticks already passed to the links
+    uint32_t *links;       //!< Links owned by this worker
+    uint32_t link_count;
+};
+
+struct tfe_link {
+    // The ring indices count up and wrap at 2^32, the position is (index & mask).
+    // They're kept in different cache lines, as they're written by different threads.
+    uint32_t head __attribute__((aligned(64))); //!< Written by tfe_feed()
+    uint32_t tail __attribute__((aligned(64))); //!< Written by the worker
+    TinyFrame *tf;
+    uint8_t *buf;
+    struct tfe_worker *worker;
+};
+
+struct TfEngine_ {
+    struct tfe_link *links;
+    uint32_t link_count;
+    struct tfe_worker *workers;
+    uint32_t worker_count;
+    uint8_t *ring_mem;
+    uint32_t ring_size;
+    uint32_t ring_mask;
+    uint32_t tick_us;
+    bool pin_workers;
+    pthread_t timer;
+    uint32_t ticks;        //!< Ticks counted by the timer thread
+    uint32_t running;
+    bool started;
+};
+
+/** Wake up a worker if it's not been woken already */
+static void tfe_wake(struct tfe_worker *w)
+{
+    // pairs with the fence in tfe_worker_main()
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&w->signalled, 1, __ATOMIC_SEQ_CST) == 0) {
+        sem_post(&w->sem);
+    }
+}
+
+/** Pass everything in a link's ring to TF_Accept(). Returns true if there was anything. */
+static bool tfe_drain(TfEngine *e, struct tfe_link *l)
+{
+    uint32_t head = LOAD_ACQ(&l->head);
+    uint32_t tail = l->tail;
+    uint32_t pos, n, first;
+
+    if (head == tail) return false;
+
+    pos = tail & e->ring_mask;
+    n = head - tail;
+    first = e->ring_size - pos;
+    if (first > n) first = n;
+
+    TF_Accept(l->tf, l->buf + pos, first);
+    if (n > first) {
+        TF_Accept(l->tf, l->buf, n - first);
+    }
+
+    STORE_REL(&l->tail, head);
+    return true;
+}
+
+static void *tfe_worker_main(void *arg)
+{
+    struct tfe_worker *w = arg;
+    TfEngine *e = w->engine;
+    bool busy;
+    uint32_t i, ticks;
+
+    while (1) {
+        __atomic_store_n(&w->signalled, 0, __ATOMIC_SEQ_CST);
+        // pairs with the fence in tfe_wake() - bytes fed after this are seen, or the worker is woken
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        busy = false;
+        for (i = 0; i < w->link_count; i++) {
+            busy |= tfe_drain(e, &e->links[w->links[i]]);
+        }
+
+        ticks = LOAD_ACQ(&e->ticks);
+        while (w->ticks_done != ticks) {
+            for (i = 0; i < w->link_count; i++) {
+                TF_Tick(e->links[w->links[i]].tf);
+            }
+            w->ticks_done++;
+        }
+
+        if (!busy) {
+            if (!LOAD_ACQ(&e->running)) break;
+            sem_wait(&w->sem);
+        }
+    }
+
+    return NULL;
+}
+
+static void *tfe_timer_main(void *arg)
+{
+    TfEngine *e = arg;
+    struct timespec period;
+    uint32_t i;
+
+    period.tv_sec = e->tick_us / 1000000;
+    period.tv_nsec = (long) (e->tick_us % 1000000) * 1000;
+
+    while (LOAD_ACQ(&e->running)) {
+        nanosleep(&period, NULL);
+        __atomic_add_fetch(&e->ticks, 1, __ATOMIC_RELEASE);
+        for (i = 0; i < e->worker_count; i++) {
+            tfe_wake(&e->workers[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/** Create the engine */
+TfEngine *tfe_create(TinyFrame **links, uint32_t link_count, const TfEngineConfig *cfg)
+{
+    TfEngine *e;
+    struct tfe_worker *w;
+    uint32_t i, size;
+
+    if (link_count == 0 || cfg->worker_count == 0) return NULL;
+
+    e = calloc(1, sizeof(TfEngine));
+    if (e == NULL) return NULL;
+
+    size = 16;
+    while (size < cfg->ring_size) size <<= 1;
+
+    e->link_count = link_count;
+    e->worker_count = cfg->worker_count;
+    e->ring_size = size;
+    e->ring_mask = size - 1;
+    e->tick_us = cfg->tick_us;
+    e->pin_workers = cfg->pin_workers;
+
+    if (posix_memalign((void **) &e->links, 64, sizeof(struct tfe_link) * link_count) != 0) {
+        e->links = NULL;
+        goto fail;
+    }
+    memset(e->links, 0, sizeof(struct tfe_link) * link_count);
+
+    e->workers = calloc(e->worker_count, sizeof(struct tfe_worker));
+    e->ring_mem = malloc((size_t) size * link_count);
+    if (e->workers == NULL || e->ring_mem == NULL) goto fail;
+
+    for (i = 0; i < e->worker_count; i++) {
+        w = &e->workers[i];
+        w->engine = e;
+        w->index = i;
+        // links i, i + worker_count, ...
+        w->links = malloc(sizeof(uint32_t) * ((link_count + e->worker_count - 1) / e->worker_count));
+        if (w->links == NULL) goto fail;
+        sem_init(&w->sem, 0, 0);
+    }
+
+    for (i = 0; i < link_count; i++) {
+        w = &e->workers[i % e->worker_count];
+        e->links[i].tf = links[i];
+        e->links[i].buf = e->ring_mem + (size_t) size * i;
+        e->links[i].worker = w;
+        w->links[w->link_count++] = i;
+    }
+
+    return e;
+
+fail:
+    tfe_destroy(e);
+    return NULL;
+}
+
+/** Start the threads */
+bool tfe_start(TfEngine *e)
+{
+    uint32_t i;
+#ifdef __linux__
+    cpu_set_t cpus;
+#endif
+
+    if (e->started) return false;
+
+    STORE_REL(&e->running, 1);
+    for (i = 0; i < e->worker_count; i++) {
+        if (pthread_create(&e->workers[i].thread, NULL, tfe_worker_main, &e->workers[i]) != 0) {
+            // stop the ones that were started
+            STORE_REL(&e->running, 0);
+            while (i-- > 0) {
+                tfe_wake(&e->workers[i]);
+                pthread_join(e->workers[i].thread, NULL);
+            }
+            return false;
+        }
+
+#ifdef __linux__
+        if (e->pin_workers) {
+            CPU_ZERO(&cpus);
+            CPU_SET(i % CPU_SETSIZE, &cpus);
+            pthread_setaffinity_np(e->workers[i].thread, sizeof(cpus), &cpus);
+        }
+#endif
+    }
+
+    if (e->tick_us > 0) {
+        if (pthread_create(&e->timer, NULL, tfe_timer_main, e) != 0) {
+            e->tick_us = 0;
+        }
+    }
+
+    e->started = true;
+    return true;
+}
+
+/** Queue bytes for a link */
+uint32_t tfe_feed(TfEngine *e, uint32_t link, const uint8_t *data, uint32_t len)
+{
+    struct tfe_link *l = &e->links[link];
+    uint32_t head = l->head;
+    uint32_t tail = LOAD_ACQ(&l->tail);
+    uint32_t space = e->ring_size - (head - tail);
+    uint32_t pos, first;
+
+    if (len > space) len = space;
+    if (len == 0) return 0;
+
+    pos = head & e->ring_mask;
+    first = e->ring_size - pos;
+    if (first > len) first = len;
+
+    memcpy(l->buf + pos, data, first);
+    memcpy(l->buf, data + first, len - first);
+
+    STORE_REL(&l->head, head + len);
+    tfe_wake(l->worker);
+    return len;
+}
+
+/** Get the worker of a link */
+uint32_t tfe_worker_of(TfEngine *e, uint32_t link)
+{
+    return link % e->worker_count;
+}
+
+/** Stop the threads */
+void tfe_stop(TfEngine *e)
+{
+    uint32_t i;
+
+    if (!e->started) return;
+
+    STORE_REL(&e->running, 0);
+    if (e->tick_us > 0) {
+        pthread_join(e->timer, NULL);
+    }
+
+    for (i = 0; i < e->worker_count; i++) {
+        tfe_wake(&e->workers[i]);
+    }
+    for (i = 0; i < e->worker_count; i++) {
+        pthread_join(e->workers[i].thread, NULL);
+    }
+
+    e->started = false;
+}
+
+/** Free the engine */
+void tfe_destroy(TfEngine *e)
+{
+    uint32_t i;
+
+    if (e == NULL) return;
+
+    tfe_stop(e);
+
+    if (e->workers) {
+        for (i = 0; i < e->worker_count; i++) {
+            if (e->workers[i].links) {
+                sem_destroy(&e->workers[i].sem);
+                free(e->workers[i].links);
+            }
+        }
+    }
+
+    free(e->workers);
+    free(e->ring_mem);
+    free(e->links);
+    free(e);
+}
@@ -0,0 +1,90 @@
+#ifndef TF_ENGINE_H
+#define TF_ENGINE_H
+
+/**
+ * TfEngine, part of the TinyFrame utilities collection
+ *
+ * MIT license.
+ *
+ * Runs many TinyFrame instances (one per link) on a pool of worker threads.
+ * Requires pthreads and a compiler with the __atomic builtins (GCC, Clang).
+ *
+ * Each link is owned by one worker (link index % worker count). Incoming bytes are
+ * given to tfe_feed(), which copies them to the link's ring buffer; the owning worker
+ * passes them to TF_Accept(), so listeners of a link always run in its worker thread.
+ * The ring is lock-free with one producer, so each link must be fed from a single
+ * thread at a time (typically the one reading the link's socket or port).
+ *
+ * A timer thread counts ticks, and the workers call TF_Tick() for their links,
+ * so TF_Tick() never runs concurrently with the parser.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../TinyFrame.h"
+
+typedef struct TfEngine_ TfEngine;
+
+/** Engine settings */
+typedef struct TfEngineConfig_ {
+    uint32_t worker_count; //!< Nr of worker threads
+    uint32_t ring_size;    //!< RX ring size per link in bytes, rounded up to a power of two
+    uint32_t tick_us;      //!< Period of TF_Tick() in microseconds, 0 = don't tick
+    bool pin_workers;      //!< Pin worker N to CPU N (Linux only)
+} TfEngineConfig;
+
+/**
+ * Create an engine for a set of instances. The instances must be initialized,
+ * and must not be used by other threads while the engine runs (except for sending,
+ * if TF_USE_MUTEX is set up).
+ *
+ * @param links - array of instances, the index is the link number
+ * @param link_count - nr of instances
+ * @param cfg - settings
+ * @return the engine, or NULL on failure
+ */
+TfEngine *tfe_create(TinyFrame **links, uint32_t link_count, const TfEngineConfig *cfg);
+
+/**
+ * Start the worker and timer threads
+ *
+ * @param e - engine
+ * @return success
+ */
+bool tfe_start(TfEngine *e);
+
+/**
+ * Pass received bytes of a link to its worker. Does not block.
+ *
+ * @param e - engine
+ * @param link - link number
+ * @param data - bytes
+ * @param len - nr of bytes
+ * @return nr of bytes taken - less than len if the link's ring is full
+ */
+uint32_t tfe_feed(TfEngine *e, uint32_t link, const uint8_t *data, uint32_t len);
+
+/**
+ * Get the worker that owns a link
+ *
+ * @param e - engine
+ * @param link - link number
+ * @return worker index
+ */
+uint32_t tfe_worker_of(TfEngine *e, uint32_t link);
+
+/**
+ * Stop the threads. Bytes already fed are processed first.
+ *
+ * @param e - engine
+ */
+void tfe_stop(TfEngine *e);
+
+/**
+ * Free the engine (stopping it if needed). The instances are not freed.
+ *
+ * @param e - engine
+ */
+void tfe_destroy(TfEngine *e);
+
+#endif // TF_ENGINE_H
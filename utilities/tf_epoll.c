@@ -0,0 +1,411 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "tf_epoll.h"
+
+#define TFL_MAX_EVENTS 64
+#define TFL_READ_CHUNK 16384
+
+struct tfl_listener {
+    int fd;
+    tfl_accept_handler accept_handler;
+    struct tfl_listener *next;
+};
+
+struct TfLoop_ {
+    int epfd;
+    int timerfd;          //!< -1 if not ticking
+    uint32_t out_max;
+    TfConn *conns;
+    struct tfl_listener *listeners;
+    uint32_t closing;     //!< Nr of connections waiting to be closed
+    bool running;
+    uint8_t rxbuf[TFL_READ_CHUNK];
+};
+
+/** Set O_NONBLOCK on a descriptor */
+static bool tfl_set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return false;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/** Write without raising SIGPIPE if the peer is gone (for sockets) */
+static ssize_t tfl_sys_write(TfConn *conn, const uint8_t *buff, uint32_t len)
+{
+    if (conn->is_socket) {
+        return send(conn->wfd, buff, len, MSG_NOSIGNAL);
+    }
+    return write(conn->wfd, buff, len);
+}
+
+/** Update the epoll registration after the output buffer got or lost data */
+static void tfl_update_events(TfConn *conn)
+{
+    struct epoll_event ev;
+    bool want_out = conn->out_len > 0;
+
+    if (want_out == conn->polling_out) return;
+    conn->polling_out = want_out;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.data.ptr = conn;
+    if (conn->rfd == conn->wfd) {
+        ev.events = EPOLLIN | (want_out ? EPOLLOUT : 0);
+    }
+    else {
+        ev.events = want_out ? EPOLLOUT : 0;
+    }
+    epoll_ctl(conn->loop->epfd, EPOLL_CTL_MOD, conn->wfd, &ev);
+}
+
+/** Create a loop */
+TfLoop *tfl_create(uint32_t tick_ms, uint32_t out_max)
+{
+    struct epoll_event ev;
+    struct itimerspec its;
+    TfLoop *loop = calloc(1, sizeof(TfLoop));
+    if (loop == NULL) return NULL;
+
+    loop->out_max = out_max;
+    loop->timerfd = -1;
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop);
+        return NULL;
+    }
+
+    if (tick_ms > 0) {
+        loop->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (loop->timerfd < 0) {
+            tfl_destroy(loop);
+            return NULL;
+        }
+
+        memset(&its, 0, sizeof(its));
+        its.it_interval.tv_sec = tick_ms / 1000;
+        its.it_interval.tv_nsec = (long) (tick_ms % 1000) * 1000000;
+        its.it_value = its.it_interval;
+        timerfd_settime(loop->timerfd, 0, &its, NULL);
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = loop; // the loop itself stands for the timer
+        epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->timerfd, &ev);
+    }
+
+    return loop;
+}
+
+/** Add a connection */
+TfConn *tfl_add(TfLoop *loop, int rfd, int wfd, TinyFrame *tf, tfl_close_handler close_handler)
+{
+    struct epoll_event ev;
+    struct stat st;
+    TfConn *conn;
+
+    if (!tfl_set_nonblock(rfd) || !tfl_set_nonblock(wfd)) return NULL;
+
+    conn = calloc(1, sizeof(TfConn));
+    if (conn == NULL) return NULL;
+
+    conn->tf = tf;
+    conn->rfd = rfd;
+    conn->wfd = wfd;
+    conn->close_handler = close_handler;
+    conn->loop = loop;
+    conn->is_socket = fstat(wfd, &st) == 0 && S_ISSOCK(st.st_mode);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, rfd, &ev) != 0) {
+        free(conn);
+        return NULL;
+    }
+
+    if (wfd != rfd) {
+        // registered without events, EPOLLOUT is enabled when there's something to write
+        ev.events = 0;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, wfd, &ev) != 0) {
+            epoll_ctl(loop->epfd, EPOLL_CTL_DEL, rfd, NULL);
+            free(conn);
+            return NULL;
+        }
+    }
+
+    tf->userdata = conn;
+
+    conn->next = loop->conns;
+    loop->conns = conn;
+    return conn;
+}
+
+/** Accept clients on a socket */
+bool tfl_listen(TfLoop *loop, int fd, tfl_accept_handler accept_handler)
+{
+    struct epoll_event ev;
+    struct tfl_listener *lst;
+
+    if (!tfl_set_nonblock(fd)) return false;
+
+    lst = calloc(1, sizeof(struct tfl_listener));
+    if (lst == NULL) return false;
+    lst->fd = fd;
+    lst->accept_handler = accept_handler;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = lst;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        free(lst);
+        return false;
+    }
+
+    lst->next = loop->listeners;
+    loop->listeners = lst;
+    return true;
+}
+
+/** Send bytes, keeping what can't be written now */
+bool tfl_write(TfConn *conn, const uint8_t *buff, uint32_t len)
+{
+    ssize_t n = 0;
+    uint32_t size;
+    uint8_t *out;
+
+    if (conn->closing) return false;
+
+    if (conn->out_len == 0) {
+        // nothing queued - try to send it right away
+        n = tfl_sys_write(conn, buff, len);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                tfl_close(conn);
+                return false;
+            }
+            n = 0;
+        }
+        buff += n;
+        len -= (uint32_t) n;
+        if (len == 0) return true;
+    }
+
+    if (conn->out_len + len > conn->loop->out_max) {
+        // the peer is not reading
+        tfl_close(conn);
+        return false;
+    }
+
+    if (conn->out_len + len > conn->out_size) {
+        size = conn->out_size ? conn->out_size : 256;
+        while (size < conn->out_len + len) size *= 2;
+        out = realloc(conn->out, size);
+        if (out == NULL) {
+            tfl_close(conn);
+            return false;
+        }
+        conn->out = out;
+        conn->out_size = size;
+    }
+
+    memcpy(conn->out + conn->out_len, buff, len);
+    conn->out_len += len;
+    tfl_update_events(conn);
+    return true;
+}
+
+/** Mark a connection to be closed */
+void tfl_close(TfConn *conn)
+{
+    if (conn->closing) return;
+    conn->closing = true;
+    conn->loop->closing++;
+}
+
+/** Write out queued bytes */
+static void tfl_flush(TfConn *conn)
+{
+    ssize_t n = tfl_sys_write(conn, conn->out, conn->out_len);
+
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            tfl_close(conn);
+        }
+        return;
+    }
+
+    conn->out_len -= (uint32_t) n;
+    memmove(conn->out, conn->out + n, conn->out_len);
+    tfl_update_events(conn);
+}
+
+/** Read what's available and parse it */
+static void tfl_receive(TfConn *conn)
+{
+    ssize_t n = read(conn->rfd, conn->loop->rxbuf, TFL_READ_CHUNK);
+
+    if (n > 0) {
+        TF_Accept(conn->tf, conn->loop->rxbuf, (uint32_t) n);
+    }
+    else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        // EOF or error
+        tfl_close(conn);
+    }
+}
+
+/** Accept waiting clients */
+static void tfl_accept(TfLoop *loop, struct tfl_listener *lst)
+{
+    int fd;
+
+    while ((fd = accept(lst->fd, NULL, NULL)) >= 0) {
+        lst->accept_handler(loop, fd);
+    }
+}
+
+/** Pass timer expirations to TF_Tick() */
+static void tfl_tick(TfLoop *loop)
+{
+    uint64_t expirations;
+    TfConn *conn;
+
+    if (read(loop->timerfd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+
+    while (expirations-- > 0) {
+        for (conn = loop->conns; conn != NULL; conn = conn->next) {
+            if (!conn->closing) TF_Tick(conn->tf);
+        }
+    }
+}
+
+/** Tear down a connection */
+static void tfl_free_conn(TfLoop *loop, TfConn *conn)
+{
+    if (conn->close_handler) {
+        conn->close_handler(loop, conn);
+    }
+
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->rfd, NULL);
+    close(conn->rfd);
+    if (conn->wfd != conn->rfd) {
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, conn->wfd, NULL);
+        close(conn->wfd);
+    }
+
+    free(conn->out);
+    free(conn);
+}
+
+/** Free connections marked for closing */
+static void tfl_reap(TfLoop *loop)
+{
+    TfConn **link = &loop->conns;
+    TfConn *conn;
+
+    while (loop->closing > 0 && *link != NULL) {
+        conn = *link;
+        if (conn->closing) {
+            *link = conn->next;
+            loop->closing--;
+            tfl_free_conn(loop, conn);
+        }
+        else {
+            link = &conn->next;
+        }
+    }
+}
+
+/** Handle one batch of events */
+bool tfl_run_once(TfLoop *loop, int timeout_ms)
+{
+    struct epoll_event events[TFL_MAX_EVENTS];
+    struct tfl_listener *lst;
+    TfConn *conn;
+    int n, i;
+
+    n = epoll_wait(loop->epfd, events, TFL_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        return errno == EINTR;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (events[i].data.ptr == loop) {
+            tfl_tick(loop);
+            continue;
+        }
+
+        for (lst = loop->listeners; lst != NULL; lst = lst->next) {
+            if (events[i].data.ptr == lst) break;
+        }
+        if (lst != NULL) {
+            tfl_accept(loop, lst);
+            continue;
+        }
+
+        conn = events[i].data.ptr;
+        if (!conn->closing && (events[i].events & EPOLLOUT)) {
+            tfl_flush(conn);
+        }
+        if (!conn->closing && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            if (events[i].events & EPOLLIN) {
+                tfl_receive(conn);
+            }
+            else {
+                // hangup / error on a descriptor without input
+                tfl_close(conn);
+            }
+        }
+    }
+
+    tfl_reap(loop);
+    return true;
+}
+
+/** Handle events until stopped */
+void tfl_run(TfLoop *loop)
+{
+    loop->running = true;
+    while (loop->running) {
+        if (!tfl_run_once(loop, -1)) break;
+    }
+}
+
+/** Stop tfl_run() */
+void tfl_stop(TfLoop *loop)
+{
+    loop->running = false;
+}
+
+/** Free the loop */
+void tfl_destroy(TfLoop *loop)
+{
+    struct tfl_listener *lst;
+    TfConn *conn;
+
+    if (loop == NULL) return;
+
+    for (conn = loop->conns; conn != NULL; conn = conn->next) {
+        tfl_close(conn);
+    }
+    tfl_reap(loop);
+
+    while (loop->listeners != NULL) {
+        lst = loop->listeners;
+        loop->listeners = lst->next;
+        close(lst->fd);
+        free(lst);
+    }
+
+    if (loop->timerfd >= 0) close(loop->timerfd);
+    close(loop->epfd);
+    free(loop);
+}
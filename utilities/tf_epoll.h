@@ -0,0 +1,142 @@
+#ifndef TF_EPOLL_H
+#define TF_EPOLL_H
+
+/**
+ * TfLoop, part of the TinyFrame utilities collection
+ *
+ * MIT license.
+ *
+ * Linux epoll transport: one thread serves any number of TinyFrame instances
+ * connected through sockets, pipes, PTYs or other pollable file descriptors.
+ *
+ * - Received bytes are read without blocking and passed to TF_Accept().
+ * - Outgoing bytes are written without blocking; what doesn't fit in the kernel
+ *   buffer is kept and sent when the descriptor is writable again.
+ *   Call tfl_write() from your TF_WriteImpl().
+ * - TF_Tick() is called for all connections from a timerfd.
+ *
+ * All functions must be called from the thread running the loop
+ * (or before it's started). Listeners run in that thread too.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../TinyFrame.h"
+
+typedef struct TfLoop_ TfLoop;
+typedef struct TfConn_ TfConn;
+
+/**
+ * Connection closed handler. Called when the peer hangs up, on a read or write error,
+ * or when tfl_close() was called. Free the TinyFrame instance here if needed.
+ * The descriptors are closed after it returns.
+ */
+typedef void (*tfl_close_handler)(TfLoop *loop, TfConn *conn);
+
+/**
+ * New client handler for a listening socket. Usually creates a TinyFrame
+ * instance and calls tfl_add().
+ */
+typedef void (*tfl_accept_handler)(TfLoop *loop, int fd);
+
+struct TfConn_ {
+    TinyFrame *tf;        //!< The instance fed by this connection
+    void *userdata;       //!< Free for the user
+    int rfd;              //!< Descriptor to read from
+    int wfd;              //!< Descriptor to write to (same as rfd for sockets and PTYs)
+    tfl_close_handler close_handler;
+
+    // --- internal ---
+    TfLoop *loop;
+    TfConn *next;
+    uint8_t *out;         //!< Bytes waiting to be written
+    uint32_t out_len;
+    uint32_t out_size;
+    bool polling_out;     //!< EPOLLOUT is enabled
+    bool is_socket;       //!< Use send() to avoid SIGPIPE
+    bool closing;
+};
+
+/**
+ * Create a loop
+ *
+ * @param tick_ms - period of TF_Tick(), 0 = don't tick
+ * @param out_max - max nr of unsent bytes kept for a connection; a peer that
+ *                  doesn't read fast enough is disconnected when it's exceeded
+ * @return the loop, or NULL on failure
+ */
+TfLoop *tfl_create(uint32_t tick_ms, uint32_t out_max);
+
+/**
+ * Add a connection. The descriptors are switched to non-blocking mode.
+ *
+ * tf->userdata is set to the connection, so TF_WriteImpl() can find it.
+ *
+ * @param loop - loop
+ * @param rfd - descriptor to read from
+ * @param wfd - descriptor to write to (can be the same as rfd)
+ * @param tf - instance that gets the received bytes
+ * @param close_handler - called when the connection is closed (can be NULL)
+ * @return the connection, or NULL on failure
+ */
+TfConn *tfl_add(TfLoop *loop, int rfd, int wfd, TinyFrame *tf, tfl_close_handler close_handler);
+
+/**
+ * Accept clients on a listening socket
+ *
+ * @param loop - loop
+ * @param fd - listening socket
+ * @param accept_handler - called with each new client socket
+ * @return success
+ */
+bool tfl_listen(TfLoop *loop, int fd, tfl_accept_handler accept_handler);
+
+/**
+ * Send bytes to a connection - use this in TF_WriteImpl(). Does not block.
+ *
+ * @param conn - connection
+ * @param buff - bytes to send
+ * @param len - nr of bytes
+ * @return success (false if the connection is closing, or its output buffer overflowed)
+ */
+bool tfl_write(TfConn *conn, const uint8_t *buff, uint32_t len);
+
+/**
+ * Close a connection. It's done after the current event is handled,
+ * so this can be called from a listener.
+ *
+ * @param conn - connection
+ */
+void tfl_close(TfConn *conn);
+
+/**
+ * Wait for events and handle them once
+ *
+ * @param loop - loop
+ * @param timeout_ms - max time to wait, -1 = forever
+ * @return false on error
+ */
+bool tfl_run_once(TfLoop *loop, int timeout_ms);
+
+/**
+ * Handle events until tfl_stop() is called
+ *
+ * @param loop - loop
+ */
+void tfl_run(TfLoop *loop);
+
+/**
+ * Make tfl_run() return
+ *
+ * @param loop - loop
+ */
+void tfl_stop(TfLoop *loop);
+
+/**
+ * Close all connections and listening sockets, and free the loop
+ *
+ * @param loop - loop
+ */
+void tfl_destroy(TfLoop *loop);
+
+#endif // TF_EPOLL_H